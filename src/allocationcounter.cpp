@@ -0,0 +1,52 @@
+#include "allocationcounter.h"
+#include "debug.h"
+
+#ifdef DEBUG
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t allocations = 0;
+}
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+uint64_t AllocationCounter::get() {
+  return allocations;
+}
+
+#else
+
+uint64_t AllocationCounter::get() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+// Number of heap allocations the calling thread has made through operator new
+// so far. Only counted in DEBUG builds, where it is used to check that the
+// search loops do not allocate; always 0 otherwise.
+class AllocationCounter {
+  public:
+    static uint64_t get();
+};
+
+#endif /* ALLOCATIONCOUNTER_H */
@@ -0,0 +1,1076 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "climbcache.h"
+#include "crossoverworkspace.h"
+#include "deadline.h"
+#include "instance.h"
+#include "localsearch.h"
+#include "mailbox.h"
+#include "movetabulist.h"
+#include "ordering.h"
+#include "population.h"
+#include "resultregister.h"
+#include "rng.h"
+#include "scoreparser.h"
+#include "scoringworkspace.h"
+#include "subsetkernel.h"
+#include "swaptabulist.h"
+#include "types.h"
+#include "workerpool.h"
+
+// Self-checks run by "make check": each fast path is compared with a plain
+// reference on random inputs and on the instances given as arguments. Every
+// mismatch is printed, and the exit code is 1 if there was any.
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const std::string &what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+    failures++;
+  }
+}
+
+std::string describe(const std::string &what, int n) {
+  std::ostringstream os;
+  os << what << " (" << n << ")";
+  return os.str();
+}
+
+// SmallBitset, inline and on the heap, against std::vector<bool>.
+void checkSmallBitset(Rng &rng) {
+  const int SIZES[] = {1, 63, 64, 65, 511, 512, 513, 1000};
+  for (int n : SIZES) {
+    Types::Bitset bits(n);
+    Types::Bitset other(n);
+    std::vector<bool> ref(n, false);
+    std::vector<bool> otherRef(n, false);
+    for (int step = 0; step < 4 * n; step++) {
+      int i = rng.uniform(n);
+      switch (rng.uniform(4)) {
+        case 0: bits.set(i); ref[i] = true; break;
+        case 1: bits.reset(i); ref[i] = false; break;
+        case 2: bits[i] = !ref[i]; ref[i] = !ref[i]; break;
+        default: other[i] = true; otherRef[i] = true; break;
+      }
+    }
+    bool same = true;
+    bool contained = true;
+    for (int i = 0; i < n; i++) {
+      same = same && bits[i] == ref[i] && bits.test(i) == ref[i];
+      contained = contained && (!otherRef[i] || ref[i]);
+    }
+    expect(same, describe("SmallBitset bits", n));
+    expect(bits.contains(other.blocks()) == contained, describe("SmallBitset contains", n));
+    Types::Bitset copy(bits);
+    expect(copy == bits, describe("SmallBitset copy", n));
+    copy &= other;
+    bool intersected = true;
+    for (int i = 0; i < n; i++) {
+      intersected = intersected && copy[i] == (ref[i] && otherRef[i]);
+    }
+    expect(intersected, describe("SmallBitset and", n));
+    if (n > 2) {
+      expect(Types::Bitset(n, 5)[2] && !Types::Bitset(n, 5)[1], describe("SmallBitset value", n));
+    }
+    bits.reset();
+    expect(bits == Types::Bitset(n), describe("SmallBitset reset", n));
+  }
+}
+
+// Each bit set with a probability drawn once per set, so that both sparse and
+// dense sets come up.
+Types::Bitset randomSet(int n, Rng &rng) {
+  Types::Bitset set(n);
+  double density = rng.real();
+  for (int i = 0; i < n; i++) {
+    if (rng.real() < density) {
+      set.set(i);
+    }
+  }
+  return set;
+}
+
+// The subset kernels at every level the CPU supports against a plain loop,
+// over all count masks and over a random increasing selection of them.
+void compareKernels(const Types::Block *masks, int numBlocks, int count, const Types::Bitset &pred, Rng &rng,
+    const std::string &what) {
+  int expected = -1;
+  for (int i = 0; i < count && expected == -1; i++) {
+    if (pred.contains(masks + (size_t)i * numBlocks)) {
+      expected = i;
+    }
+  }
+  std::vector<int> ids;
+  int expectedIndexed = -1;
+  for (int i = 0; i < count; i++) {
+    if (rng.uniform(2)) {
+      if (expectedIndexed == -1 && pred.contains(masks + (size_t)i * numBlocks)) {
+        expectedIndexed = ids.size();
+      }
+      ids.push_back(i);
+    }
+  }
+  const SubsetKernel::Level LEVELS[] = {SubsetKernel::SCALAR, SubsetKernel::AVX2, SubsetKernel::AVX512};
+  for (SubsetKernel::Level level : LEVELS) {
+    if (!SubsetKernel::setLevel(level)) {
+      continue;
+    }
+    expect(SubsetKernel::firstSubset(masks, numBlocks, count, pred.blocks()) == expected,
+        what + " firstSubset " + SubsetKernel::getName());
+    expect(SubsetKernel::firstSubsetIndexed(masks, numBlocks, ids.data(), ids.size(), pred.blocks()) == expectedIndexed,
+        what + " firstSubsetIndexed " + SubsetKernel::getName());
+  }
+}
+
+// Random masks of up to 9 blocks.
+void checkKernels(Rng &rng) {
+  SubsetKernel::Level original = SubsetKernel::getLevel();
+  const int BLOCK_COUNTS[] = {1, 2, 3, 4, 8, 9};
+  for (int numBlocks : BLOCK_COUNTS) {
+    int n = numBlocks * Types::BLOCK_BITS;
+    for (int trial = 0; trial < 50; trial++) {
+      int count = rng.uniform(100);
+      std::vector<Types::Block> masks;
+      for (int i = 0; i < count; i++) {
+        Types::Bitset set(n);
+        // Masks with few parents, like parent sets, so that some are subsets.
+        for (int k = rng.uniform(4); k > 0; k--) {
+          set.set(rng.uniform(n));
+        }
+        masks.insert(masks.end(), set.blocks(), set.blocks() + numBlocks);
+      }
+      compareKernels(masks.data(), numBlocks, count, randomSet(n, rng), rng, describe("Random masks", numBlocks));
+    }
+  }
+  SubsetKernel::setLevel(original);
+}
+
+// The masks of the instance against random predecessor sets.
+void checkKernels(const Instance &instance, Rng &rng) {
+  SubsetKernel::Level original = SubsetKernel::getLevel();
+  const ParentSetStore &store = instance.getStore();
+  if (store.hasMasks()) {
+    int n = instance.getN();
+    for (int trial = 0; trial < 20 * n; trial++) {
+      const Variable &var = instance.getVar(rng.uniform(n));
+      int count = var.numParents() ? 1 + rng.uniform(var.numParents()) : 0;
+      compareKernels(store.getMask(var.getOffset()), store.getNumBlocks(), count, randomSet(n, rng), rng,
+          describe("Variable", var.getId()));
+    }
+  }
+  SubsetKernel::setLevel(original);
+}
+
+// Rank of the first set of var below limit that is a subset of pred and
+// contains required (unless -1), or -1.
+int scanConsistent(const Instance &instance, const Variable &var, const Types::Bitset &pred, int limit, int required) {
+  for (int r = 0; r < limit; r++) {
+    if (var.isConsistent(r, pred) && (required == -1 || instance.getStore().hasElement(var.getOffset() + r, required))) {
+      return r;
+    }
+  }
+  return -1;
+}
+
+// ParentIndex, and the Variable lookups built on it or on the parent lists,
+// against a scan of the sets in score order.
+void checkIndex(const Instance &instance, Rng &rng) {
+  if (instance.usesPositions()) {
+    return;
+  }
+  const ParentSetStore &store = instance.getStore();
+  int n = instance.getN();
+  for (int trial = 0; trial < 20 * n; trial++) {
+    const Variable &var = instance.getVar(rng.uniform(n));
+    int m = var.numParents();
+    Types::Bitset pred = randomSet(n, rng);
+    int limit = rng.uniform(m + 1);
+    int required = -1;
+    if (m > 0) {
+      ParentList parents = store.getParents(var.getOffset() + rng.uniform(m));
+      required = parents.size() ? parents[rng.uniform(parents.size())] : rng.uniform(n);
+      pred.set(required);
+    }
+    int expected = scanConsistent(instance, var, pred, m, -1);
+    expect(var.firstConsistent(pred) == expected, describe("Variable::firstConsistent", var.getId()));
+    int expectedWith = required == -1 ? -1 : scanConsistent(instance, var, pred, limit, required);
+    if (required != -1) {
+      expect(var.firstConsistentWithParent(pred, required, limit) == expectedWith,
+          describe("Variable::firstConsistentWithParent", var.getId()));
+    }
+    if (var.getIndexSlot() != -1) {
+      const ParentIndex &index = instance.getIndex();
+      expect(index.firstConsistent(var.getIndexSlot(), pred, m, -1) == expected,
+          describe("ParentIndex::firstConsistent", var.getId()));
+      expect(index.firstConsistent(var.getIndexSlot(), pred, limit, required) == expectedWith,
+          describe("ParentIndex::firstConsistent with a parent", var.getId()));
+    }
+  }
+}
+
+template <class T>
+bool sameArray(const T *a, const T *b, size_t count) {
+  return count == 0 || std::equal(a, a + count, b);
+}
+
+// An instance written as an image and mapped back, in both consistency
+// modes, must hold the same arrays as the one parsed from text.
+void checkImage(const std::string &fileName) {
+  const std::string IMAGE = "selfcheck.img";
+  for (int positionMode = 0; positionMode <= 1; positionMode++) {
+    Instance text(fileName, positionMode);
+    text.writeImage(IMAGE);
+    Instance image(IMAGE);
+    std::remove(IMAGE.c_str());
+    const std::string what = positionMode ? "Image with positions" : "Image with masks";
+    int n = text.getN();
+    expect(image.getN() == n && image.usesPositions() == text.usesPositions(), what + ": header");
+    if (image.getN() != n) {
+      continue;
+    }
+    bool sameVars = true;
+    for (int i = 0; i < n; i++) {
+      const Variable &a = text.getVar(i);
+      const Variable &b = image.getVar(i);
+      sameVars = sameVars && a.getId() == b.getId() && a.getOffset() == b.getOffset() &&
+        a.numParents() == b.numParents() && a.getIndexSlot() == b.getIndexSlot();
+    }
+    expect(sameVars, what + ": variables");
+    const ParentSetStore &s = text.getStore();
+    const ParentSetStore &t = image.getStore();
+    int size = s.getSize();
+    expect(t.getSize() == size && t.getListSize() == s.getListSize() && t.hasMasks() == s.hasMasks() &&
+        sameArray(s.scoreData(), t.scoreData(), size) && sameArray(s.offsetData(), t.offsetData(), size + 1) &&
+        sameArray(s.listData(), t.listData(), s.getListSize()) &&
+        (!s.hasMasks() || sameArray(s.maskData(), t.maskData(), (size_t)size * s.getNumBlocks())), what + ": parent sets");
+    int numRows = s.getNumRows();
+    expect(t.getNumRows() == numRows && sameArray(s.rowStartData(), t.rowStartData(), n + 1) &&
+        (s.denseParentLists() || sameArray(s.rowKeyData(), t.rowKeyData(), numRows)) &&
+        sameArray(s.rowOffsetData(), t.rowOffsetData(), numRows + 1) &&
+        sameArray(s.rowRankData(), t.rowRankData(), s.rowOffsetData()[numRows]), what + ": parent lists");
+    const ParentIndex &x = text.getIndex();
+    const ParentIndex &y = image.getIndex();
+    int numSlots = x.getNumSlots();
+    expect(y.getNumSlots() == numSlots && sameArray(x.countData(), y.countData(), numSlots) &&
+        sameArray(x.offsetData(), y.offsetData(), numSlots + 1) &&
+        sameArray(x.parentData(), y.parentData(), numSlots ? x.offsetData()[numSlots] : 0) &&
+        sameArray(x.bitOffsetData(), y.bitOffsetData(), numSlots + 1) &&
+        sameArray(x.bitData(), y.bitData(), numSlots ? x.bitOffsetData()[numSlots] : 0), what + ": index");
+  }
+}
+
+// Pruning against a pairwise search for a proper subset that scores no
+// worse, and the best score of random orderings with and without pruning.
+void checkPruning(const std::string &fileName, Rng &rng) {
+  Instance full(fileName, 0);
+  Instance pruned(fileName, 0, true);
+  const ParentSetStore &store = full.getStore();
+  const ParentSetStore &kept = pruned.getStore();
+  int n = full.getN();
+  for (int v = 0; v < n; v++) {
+    const Variable &var = full.getVar(v);
+    const Variable &prunedVar = pruned.getVar(v);
+    int r = 0;
+    bool same = true;
+    for (int j = 0; j < var.numParents() && same; j++) {
+      int idx = var.getOffset() + j;
+      ParentList parents = store.getParents(idx);
+      Types::Bitset set(n);
+      for (int p : parents) {
+        set.set(p);
+      }
+      bool dominated = false;
+      for (int t = 0; t < var.numParents() && !dominated; t++) {
+        int other = var.getOffset() + t;
+        dominated = store.getScore(other) <= store.getScore(idx) && store.getParents(other).size() < parents.size() &&
+          set.contains(store.getMask(other));
+      }
+      if (dominated) {
+        continue;
+      }
+      int keptIdx = prunedVar.getOffset() + r;
+      same = r < prunedVar.numParents() && kept.getScore(keptIdx) == store.getScore(idx) &&
+        kept.getParents(keptIdx).size() == parents.size() &&
+        std::equal(parents.begin(), parents.end(), kept.getParents(keptIdx).begin());
+      r++;
+    }
+    expect(same && r == prunedVar.numParents(), describe("Pruned sets of variable", v));
+  }
+  LocalSearch fullSearch(full);
+  LocalSearch prunedSearch(pruned);
+  ScoringWorkspace ws(n);
+  for (int trial = 0; trial < 20; trial++) {
+    Ordering o = Ordering::randomOrdering(full, rng);
+    expect(fullSearch.getBestScore(o, ws) == prunedSearch.getBestScore(o, ws), "Best score after pruning");
+  }
+}
+
+// parseDouble against strtod: same bits, and stopping at the same character.
+bool parsesLikeStrtod(const std::string &text) {
+  const char *p = text.data();
+  double value = ScoreParser::parseDouble(p, text.data() + text.size());
+  char *stop;
+  double expected = std::strtod(text.c_str(), &stop);
+  return std::memcmp(&value, &expected, sizeof(double)) == 0 && p - text.data() == stop - text.c_str();
+}
+
+// Tokens around the limits of the exact path (19 digit mantissas, 2^53 and
+// powers of ten up to 1e22), then random ones with signs, leading zeros,
+// exponents and line ends.
+void checkParseDouble(Rng &rng) {
+  const char *TOKENS[] = {
+    "0", "-0", "+0.5", "007.25", "-00012.5e+3", ".5", "5.", "-.25", "2.5e", "2.5e+", "1.5E-22", "1.5\r",
+    "-96.093098\r\n", "1e22", "1e23", "1e-22", "1e-23", "-4.5e22", "4.5e-23", "9007199254740992",
+    "9007199254740993", "1234567890123456789", "9999999999999999999", "12345678901234567890",
+    "99999999999999999999", "0.1234567890123456789", "-1234567890.123456789e-22", "123456789012345678.9e23",
+    "1e400", "1e-400", "0e9999"
+  };
+  for (const char *token : TOKENS) {
+    expect(parsesLikeStrtod(token), std::string("parseDouble ") + token);
+  }
+  const char *SIGNS[] = {"", "-", "+"};
+  const char *ENDS[] = {"", " ", "\r", "\r\n", "\n"};
+  for (int trial = 0; trial < 20000; trial++) {
+    std::string token = SIGNS[rng.uniform(3)];
+    token.append(rng.uniform(4) ? 0 : 1 + rng.uniform(3), '0');
+    int numDigits = 1 + rng.uniform(20);
+    int point = rng.uniform(numDigits + 2);
+    for (int d = 0; d < numDigits; d++) {
+      if (d == point) {
+        token += '.';
+      }
+      token += (char)('0' + rng.uniform(10));
+    }
+    if (rng.uniform(2)) {
+      std::ostringstream exponent;
+      exponent << "eE"[rng.uniform(2)] << SIGNS[rng.uniform(3)] << rng.uniform(26);
+      token += exponent.str();
+    }
+    token += ENDS[rng.uniform(5)];
+    expect(parsesLikeStrtod(token), "parseDouble " + token);
+  }
+}
+
+// The parallel parser against reading the file with operator>>. Sets of
+// equal score may come out of the parser in any order, so both sides are
+// sorted by score and parents before comparing.
+void checkParser(const std::string &fileName) {
+  typedef std::pair<Types::Score, std::vector<int>> Set;
+  // ScoreParser's scaling: scores are stored negated, in millionths.
+  const double SCORE_SCALE = -1000000;
+  std::ifstream in(fileName.c_str());
+  int n;
+  in >> n;
+  std::vector<int> varIds;
+  std::vector<std::vector<Set>> expected;
+  int varId;
+  int count;
+  while (in >> varId >> count) {
+    varIds.push_back(varId);
+    expected.push_back(std::vector<Set>(count));
+    for (Set &set : expected.back()) {
+      double score;
+      int size;
+      in >> score >> size;
+      set.first = (Types::Score)(score * SCORE_SCALE);
+      set.second.resize(size);
+      for (int &p : set.second) {
+        in >> p;
+      }
+    }
+    std::sort(expected.back().begin(), expected.back().end());
+  }
+  WorkerPool pool(4);
+  ParentSetStore store;
+  ScoreParser parser(fileName);
+  parser.parse(pool, store);
+  std::vector<ScoreParser::Block> &blocks = parser.getBlocks();
+  expect(parser.getN() == n && blocks.size() == expected.size(), "Parsed blocks of " + fileName);
+  for (size_t b = 0; b < blocks.size() && b < expected.size(); b++) {
+    const ScoreParser::Block &block = blocks[b];
+    const int *offsets = store.mutableOffsets() + block.first;
+    const int *list = store.mutableList();
+    std::vector<Set> parsed(block.count);
+    for (int j = 0; j < block.count; j++) {
+      parsed[j].first = store.mutableScores()[block.first + j];
+      parsed[j].second.assign(list + offsets[j], list + offsets[j + 1]);
+    }
+    std::sort(parsed.begin(), parsed.end());
+    expect(block.varId == varIds[b] && parsed == expected[b], describe("Parsed block", b));
+  }
+}
+
+Types::Score insertScore(LocalSearch &search, const Ordering &o, int from, int to, ScoringWorkspace &scratch) {
+  Ordering moved(o);
+  moved.insert(from, to);
+  return search.getBestScore(moved, scratch);
+}
+
+// The parent sets and scores a move keeps in ws against a recomputation for
+// o: among sets of equal score the one kept may differ from the first.
+bool keptUpToDate(const Instance &instance, LocalSearch &search, const Ordering &o, Types::Score score,
+    const ScoringWorkspace &ws, ScoringWorkspace &scratch) {
+  int n = instance.getN();
+  bool consistent = true;
+  Types::Bitset pred(n);
+  for (int i = 0; i < n; i++) {
+    const Variable &var = instance.getVar(o.get(i));
+    int v = var.getId();
+    consistent = consistent && var.isConsistent(ws.parents[v], pred) &&
+      var.getParent(ws.parents[v]).getScore() == ws.scores[v];
+    pred.set(v);
+  }
+  return search.getBestScoreWithParents(o, scratch.parents, scratch.scores, scratch) == score &&
+    scratch.scores == ws.scores && consistent;
+}
+
+// getBestInsertFast against rescoring every insert of the pivot from scratch,
+// from random and from climbed orderings, and the parent sets kept up to date
+// by applyBestInsert against recomputed ones.
+void checkInsert(const Instance &instance, Rng &rng) {
+  int n = instance.getN();
+  LocalSearch search(instance);
+  ScoringWorkspace ws(n);
+  ScoringWorkspace scratch(n);
+  Deadline never;
+  const std::string mode = instance.usesPositions() ? " with positions" : " with masks";
+  for (int trial = 0; trial < 6; trial++) {
+    Ordering o = Ordering::randomOrdering(instance, rng);
+    if (trial % 2) {
+      o = search.hillClimb(o, ws, rng, never).getOrdering();
+    }
+    Types::Score score = search.getBestScoreWithParents(o, ws.parents, ws.scores, ws);
+    for (int pivot = 0; pivot < n; pivot++) {
+      Types::Score best = score;
+      for (int dest = 0; dest < n; dest++) {
+        if (dest != pivot) {
+          best = std::min(best, insertScore(search, o, pivot, dest, scratch));
+        }
+      }
+      uint64_t hash = o.getHash();
+      FastPivotResult result = search.getBestInsertFast(o, pivot, score, ws, never);
+      int dest = result.getSwapIdx();
+      expect(result.getScore() == best && (dest == -1) == (best == score) && o.getHash() == hash, "getBestInsertFast" + mode);
+      if (dest == -1) {
+        continue;
+      }
+      expect(insertScore(search, o, pivot, dest, scratch) == best, "getBestInsertFast destination" + mode);
+      search.applyBestInsert(o, pivot, dest, ws);
+      score = best;
+      expect(keptUpToDate(instance, search, o, score, ws, scratch), "applyBestInsert" + mode);
+    }
+  }
+}
+
+Ordering shuffled(int n, Rng &rng) {
+  std::vector<int> vars(n);
+  std::iota(vars.begin(), vars.end(), 0);
+  rng.shuffle(vars.begin(), vars.end());
+  Ordering o(n);
+  for (int i = 0; i < n; i++) {
+    o.set(i, vars[i]);
+  }
+  return o;
+}
+
+// Order based crossover as first written: positions drawn by coin flip keep
+// the variable of o1, the others are filled in the order of o2.
+Ordering referenceOB(const Ordering &o1, const Ordering &o2, Rng &rng) {
+  int n = o1.getSize();
+  Ordering crossed(n);
+  std::vector<char> kept(n, 0);
+  std::vector<char> used(n, 0);
+  for (int i = 0; i < n; i++) {
+    if (rng.uniform(2)) {
+      kept[i] = 1;
+      used[o1.get(i)] = 1;
+      crossed.set(i, o1.get(i));
+    }
+  }
+  for (int i = 0, j = 0; i < n; i++) {
+    if (!kept[i]) {
+      while (used[o2.get(j)]) {
+        j++;
+      }
+      used[o2.get(j)] = 1;
+      crossed.set(i, o2.get(j));
+    }
+  }
+  return crossed;
+}
+
+// Rank keys as first written: variables sorted by the sum of their positions,
+// ties shuffled.
+Ordering referenceRK(const Ordering &o1, const Ordering &o2, Rng &rng) {
+  int n = o1.getSize();
+  std::map<int, std::vector<int>> byRank;
+  for (int v = 0; v < n; v++) {
+    byRank[o1.getPosition(v) + o2.getPosition(v)].push_back(v);
+  }
+  Ordering crossed(n);
+  int next = 0;
+  for (auto &rank : byRank) {
+    std::vector<int> &vars = rank.second;
+    if (vars.size() > 1) {
+      rng.shuffle(vars.begin(), vars.end());
+    }
+    for (int v : vars) {
+      crossed.set(next++, v);
+    }
+  }
+  return crossed;
+}
+
+// The child must be a permutation with a consistent hash and positions.
+bool wellFormed(const Ordering &crossed, int n) {
+  Ordering rebuilt(n);
+  std::vector<int> seen(n, 0);
+  bool ok = crossed.getSize() == n;
+  for (int i = 0; ok && i < n; i++) {
+    int v = crossed.get(i);
+    ok = v >= 0 && v < n && seen[v]++ == 0 && crossed.getPosition(v) == i;
+    rebuilt.set(i, v);
+  }
+  return ok && rebuilt.getHash() == crossed.getHash();
+}
+
+// The linear time crossovers against the map and scan based versions they
+// replaced, drawing the same random numbers. Cycle crossover has no random
+// choices to replay, so the child is checked to take every cycle of positions
+// whole from one parent.
+void checkCrossovers(Rng &rng) {
+  for (int trial = 0; trial < 2000; trial++) {
+    int n = 1 + rng.uniform(60);
+    Ordering a = shuffled(n, rng);
+    Ordering b = trial % 3 ? shuffled(n, rng) : a;
+    if (trial % 5 == 0) {
+      for (int k = 0; k < 3; k++) {
+        b.swap(rng.uniform(n), rng.uniform(n));
+      }
+    }
+    CrossoverWorkspace cw(n);
+    Ordering crossed;
+    uint64_t seed = rng.next();
+    Rng fast(seed);
+    Rng reference(seed);
+    Population::crossoverOB(a, b, fast, cw, crossed);
+    expect(wellFormed(crossed, n) && crossed.equals(referenceOB(a, b, reference)), describe("crossoverOB", n));
+    Population::crossoverRK(a, b, fast, cw, crossed);
+    expect(wellFormed(crossed, n) && crossed.equals(referenceRK(a, b, reference)), describe("crossoverRK", n));
+    Population::crossoverCX(a, b, fast, cw, crossed);
+    bool cycles = wellFormed(crossed, n);
+    for (int i = 0; cycles && i < n; i++) {
+      bool fromA = crossed.get(i) == a.get(i);
+      int next = a.getPosition(b.get(i));
+      cycles = (fromA || crossed.get(i) == b.get(i)) &&
+        (a.get(i) == b.get(i) || fromA == (crossed.get(next) == a.get(next)));
+    }
+    expect(cycles, describe("crossoverCX", n));
+  }
+}
+
+// The hashed tabu counts against scanning the last MAX_SIZE entries, also for
+// n past where an n * n table would overflow an int index.
+void checkTabuLists(Rng &rng) {
+  const int SIZES[] = {5, 60, 70000};
+  for (int n : SIZES) {
+    int tenure = 1 + rng.uniform(20);
+    MoveTabuList moves(tenure, n);
+    SwapTabuList swaps(tenure, n);
+    std::deque<std::pair<int, int>> lastMoves;
+    std::deque<std::pair<int, int>> lastSwaps;
+    Ordering o = shuffled(n, rng);
+    bool same = true;
+    for (int step = 0; step < 500; step++) {
+      int pos = rng.uniform(n);
+      std::pair<int, int> move(o.get(pos), rng.uniform(2) ? pos : (int)rng.uniform(n));
+      moves.add(move.first, move.second);
+      lastMoves.push_back(move);
+      std::pair<int, int> swap(rng.uniform(n), rng.uniform(n));
+      swaps.add(swap.first, swap.second);
+      lastSwaps.push_back(swap);
+      if ((int)lastMoves.size() > tenure) {
+        lastMoves.pop_front();
+        lastSwaps.pop_front();
+      }
+      bool moved = false;
+      bool placed = false;
+      int var = rng.uniform(n);
+      for (const std::pair<int, int> &m : lastMoves) {
+        moved = moved || m.first == var;
+        placed = placed || o.get(m.second) == m.first;
+      }
+      int a = rng.uniform(2) ? swap.second : (int)rng.uniform(n);
+      int b = rng.uniform(2) ? swap.first : (int)rng.uniform(n);
+      bool swapped = false;
+      for (const std::pair<int, int> &p : lastSwaps) {
+        swapped = swapped || (p.first == a && p.second == b) || (p.first == b && p.second == a);
+      }
+      same = same && moves.contains(var) == moved && moves.contains(o) == placed && swaps.contains(a, b) == swapped;
+    }
+    expect(same, describe("tabu lists", n));
+  }
+}
+
+// greedyOrdering against placing variables one at a time: with greediness 1
+// it must pick what findSmallestConsistentWithOrdering picks, and otherwise
+// each pick must score no worse than the greediness-th best candidate.
+void checkGreedy(const Instance &instance, Rng &rng) {
+  int n = instance.getN();
+  Ordering reference(n);
+  for (int i = 0; i < n; i++) {
+    reference.set(i, reference.findSmallestConsistentWithOrdering(i, instance));
+  }
+  expect(Ordering::greedyOrdering(instance, 1, rng).equals(reference), describe("greedyOrdering of greediness", 1));
+  const int GREEDINESS[] = {2, 5, 10};
+  for (int greediness : GREEDINESS) {
+    Ordering o = Ordering::greedyOrdering(instance, greediness, rng);
+    bool amongBest = wellFormed(o, n);
+    Types::Bitset pred(n);
+    for (int i = 0; i < n && amongBest; i++) {
+      std::vector<Types::Score> scores;
+      Types::Score picked = Types::SCORE_MAX;
+      for (int v = 0; v < n; v++) {
+        const Variable &var = instance.getVar(v);
+        int j = pred[v] ? -1 : var.firstConsistent(pred);
+        if (j != -1) {
+          scores.push_back(var.getParent(j).getScore());
+          if (v == o.get(i)) {
+            picked = scores.back();
+          }
+        }
+      }
+      int k = std::min(greediness, (int)scores.size());
+      std::nth_element(scores.begin(), scores.begin() + k - 1, scores.end());
+      amongBest = picked <= scores[k - 1];
+      pred.set(o.get(i));
+    }
+    expect(amongBest, describe("greedyOrdering of greediness", greediness));
+  }
+}
+
+int referenceDepth(const Instance &instance, const std::vector<int> &setOf, int var, std::vector<int> &depth) {
+  if (depth[var] == -1) {
+    depth[var] = 0;
+    for (int parent : instance.getVar(var).getParent(setOf[var]).getParentsVec()) {
+      depth[var] = std::max(depth[var], referenceDepth(instance, setOf, parent, depth) + 1);
+    }
+  }
+  return depth[var];
+}
+
+// depthSort against depths found by recursion over the best parent sets and
+// a stable sort of the variables by depth.
+void checkDepthSort(const Instance &instance, Rng &rng) {
+  int n = instance.getN();
+  LocalSearch search(instance);
+  for (int trial = 0; trial < 10; trial++) {
+    Ordering o = trial ? Ordering::randomOrdering(instance, rng) : Ordering::greedyOrdering(instance, 1, rng);
+    std::vector<int> parentIds = search.bestParentIds(o);
+    std::vector<int> setOf(n);
+    for (int i = 0; i < n; i++) {
+      setOf[o.get(i)] = parentIds[i];
+    }
+    std::vector<int> depth(n, -1);
+    std::vector<int> vars(n);
+    for (int v = 0; v < n; v++) {
+      referenceDepth(instance, setOf, v, depth);
+      vars[v] = v;
+    }
+    std::stable_sort(vars.begin(), vars.end(), [&depth](int a, int b) {
+      return depth[a] < depth[b];
+    });
+    Ordering sorted = search.depthSort(o);
+    bool same = true;
+    for (int i = 0; i < n; i++) {
+      same = same && sorted.get(i) == vars[i];
+    }
+    expect(same, describe("depthSort", n));
+  }
+}
+
+// Threads record random scores, each with an ordering rotated by the thread
+// id. The register must keep the best score, and the dump must list every
+// improvement it accepted exactly once, in descending score order.
+void checkResultRegister(Rng &rng) {
+  const int NUM_THREADS = 8;
+  const int NUM_RECORDS = 2000;
+  const std::string DUMP = "selfcheck.out";
+  std::vector<std::vector<Types::Score>> accepted(NUM_THREADS);
+  Types::Score best = Types::SCORE_MAX;
+  {
+    ResultRegister rr;
+    std::vector<std::thread> threads;
+    std::vector<Types::Score> lowest(NUM_THREADS, Types::SCORE_MAX);
+    std::vector<uint64_t> seeds(NUM_THREADS);
+    for (uint64_t &seed : seeds) {
+      seed = rng.next();
+    }
+    for (int t = 0; t < NUM_THREADS; t++) {
+      threads.push_back(std::thread([&, t]() {
+        Rng local(seeds[t], t);
+        Ordering o(NUM_THREADS);
+        for (int i = 0; i < NUM_THREADS; i++) {
+          o.set(i, (i + t) % NUM_THREADS);
+        }
+        for (int r = 0; r < NUM_RECORDS; r++) {
+          Types::Score score = 1 + local.uniform(1000000);
+          if (rr.record(score, o)) {
+            accepted[t].push_back(score);
+          }
+          lowest[t] = std::min(lowest[t], score);
+        }
+      }));
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    for (int t = 0; t < NUM_THREADS; t++) {
+      best = std::min(best, lowest[t]);
+    }
+    expect(rr.getBest() == best, "ResultRegister best score");
+    rr.dump(DUMP);
+  }
+  std::map<std::pair<Types::Score, int>, int> unlisted;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    for (Types::Score score : accepted[t]) {
+      unlisted[std::make_pair(score, t)]++;
+    }
+  }
+  std::ifstream in(DUMP.c_str());
+  std::string line;
+  std::getline(in, line);
+  std::getline(in, line);
+  long time;
+  Types::Score score;
+  Types::Score previous = Types::SCORE_MAX;
+  bool ordered = true;
+  while (in >> time >> score) {
+    std::vector<int> vars(NUM_THREADS);
+    for (int &var : vars) {
+      in >> var;
+    }
+    int t = vars[0];
+    for (int i = 0; i < NUM_THREADS; i++) {
+      ordered = ordered && vars[i] == (i + t) % NUM_THREADS;
+    }
+    ordered = ordered && score < previous && --unlisted[std::make_pair(score, t)] == 0;
+    previous = score;
+  }
+  bool complete = previous == best;
+  for (const std::pair<const std::pair<Types::Score, int>, int> &entry : unlisted) {
+    complete = complete && entry.second == 0;
+  }
+  expect(ordered && complete, "ResultRegister dump");
+  std::remove(DUMP.c_str());
+}
+
+// ClimbCache misses until an ordering is inserted, then hits from several
+// threads at once, until an ordering that maps to the same slot replaces it.
+// A capacity of 0 never hits and counts no lookups.
+void checkClimbCache(Rng &rng) {
+  const int N = 12;
+  const int CAPACITY = 5;
+  ClimbCache cache(CAPACITY);
+  std::vector<Ordering> starts;
+  std::vector<uint64_t> slots;
+  // Capacity rounds up to 8: one ordering per slot, plus one sharing slot 0.
+  while (starts.size() < 9) {
+    Ordering o = shuffled(N, rng);
+    uint64_t slot = o.getHash() & 7;
+    if (std::find(slots.begin(), slots.end(), slot) == slots.end() || (starts.size() == 8 && slot == slots[0])) {
+      starts.push_back(o);
+      slots.push_back(slot);
+    }
+  }
+  SearchResult climbed;
+  bool missed = true;
+  for (int i = 0; i < 8; i++) {
+    missed = missed && !cache.find(starts[i], climbed);
+    cache.insert(starts[i], SearchResult(i, starts[i]));
+  }
+  expect(missed && cache.getHits() == 0 && cache.getLookups() == 8, "ClimbCache misses");
+  const int NUM_THREADS = 4;
+  std::vector<int> found(NUM_THREADS, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    threads.push_back(std::thread([&, t]() {
+      SearchResult result;
+      for (int r = 0; r < 1000; r++) {
+        int i = (r + t) % 8;
+        found[t] += cache.find(starts[i], result) && result.getScore() == i && result.getOrdering().equals(starts[i]);
+      }
+    }));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  bool hit = true;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    hit = hit && found[t] == 1000;
+  }
+  expect(hit && cache.getHits() == NUM_THREADS * 1000 && cache.getLookups() == 8 + NUM_THREADS * 1000, "ClimbCache hits");
+  cache.insert(starts[8], SearchResult(8, starts[8]));
+  bool evicted = !cache.find(starts[0], climbed) && cache.find(starts[8], climbed) && climbed.getScore() == 8;
+  for (int i = 1; i < 8; i++) {
+    evicted = evicted && cache.find(starts[i], climbed) && climbed.getScore() == i;
+  }
+  expect(evicted, "ClimbCache eviction");
+  ClimbCache disabled(0);
+  disabled.insert(starts[0], SearchResult(0, starts[0]));
+  expect(!disabled.find(starts[0], climbed) && disabled.getLookups() == 0, "ClimbCache disabled");
+}
+
+// Several threads send distinct specimens through a small Mailbox, retrying
+// when it is full, while others receive: every specimen must come out exactly
+// once, intact.
+void checkMailbox() {
+  const int NUM_SENDERS = 4;
+  const int NUM_RECEIVERS = 4;
+  const int NUM_SPECIMENS = 20000;
+  Mailbox mailbox(16);
+  std::atomic<int> numReceived(0);
+  std::vector<std::vector<int>> received(NUM_RECEIVERS);
+  std::vector<int> corrupted(NUM_RECEIVERS, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_SENDERS; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (int id = t; id < NUM_SPECIMENS; id += NUM_SENDERS) {
+        Ordering o(2);
+        o.set(0, id % 2);
+        o.set(1, 1 - id % 2);
+        SearchResult sr(id, o);
+        while (!mailbox.send(sr)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  for (int t = 0; t < NUM_RECEIVERS; t++) {
+    threads.push_back(std::thread([&, t]() {
+      SearchResult sr;
+      // A lost specimen fails the check instead of hanging it.
+      Deadline giveUp = Deadline::in(10);
+      while (numReceived.load() < NUM_SPECIMENS && !giveUp.reached()) {
+        if (!mailbox.receive(sr)) {
+          std::this_thread::yield();
+          continue;
+        }
+        numReceived++;
+        int id = sr.getScore();
+        corrupted[t] += sr.getOrdering().get(0) != id % 2 || sr.getOrdering().get(1) != 1 - id % 2;
+        received[t].push_back(id);
+      }
+    }));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  std::vector<int> times(NUM_SPECIMENS, 0);
+  bool intact = true;
+  for (int t = 0; t < NUM_RECEIVERS; t++) {
+    intact = intact && corrupted[t] == 0;
+    for (int id : received[t]) {
+      intact = intact && id >= 0 && id < NUM_SPECIMENS && ++times[id] == 1;
+    }
+  }
+  SearchResult left;
+  expect(intact && std::count(times.begin(), times.end(), 1) == NUM_SPECIMENS && !mailbox.receive(left),
+      "Mailbox delivers every specimen once");
+}
+
+// getInsertScore against rescoring the move from scratch, with and without
+// a cut off: a move cut short must really be worse than allowed.
+void checkInsertScore(const Instance &instance, Rng &rng) {
+  int n = instance.getN();
+  if (n < 2) {
+    return;
+  }
+  LocalSearch search(instance);
+  ScoringWorkspace ws(n);
+  ScoringWorkspace scratch(n);
+  const std::string mode = instance.usesPositions() ? " with positions" : " with masks";
+  Ordering o = Ordering::randomOrdering(instance, rng);
+  Types::Score score = search.getBestScoreWithParents(o, ws.parents, ws.scores, ws);
+  for (int trial = 0; trial < 100 * n; trial++) {
+    int i = rng.uniform(n);
+    int j = rng.uniform(n - 1);
+    j += j >= i;
+    Types::Score maxDelta = rng.uniform(3) ? (Types::Score)(rng.real() * rng.real() * 1e7) : -1;
+    // Moving forward, j is the position the pivot ends up in front of.
+    Types::Score expected = insertScore(search, o, i, i < j ? j - 1 : j, scratch);
+    uint64_t hash = o.getHash();
+    FastPivotResult cut = search.getInsertScore(o, i, j, score, ws, maxDelta);
+    if (cut.getSwapIdx() == -1) {
+      expect(expected - score > maxDelta && cut.getScore() - score > maxDelta, "getInsertScore cut off" + mode);
+    } else {
+      expect(cut.getScore() == expected, "getInsertScore with a cut off" + mode);
+    }
+    FastPivotResult full = search.getInsertScore(o, i, j, score, ws);
+    expect(full.getScore() == expected && full.getSwapIdx() != -1 && o.getHash() == hash, "getInsertScore" + mode);
+    // Apply some moves, mostly improving ones, so that orderings improve.
+    if (expected <= score || rng.uniform(8) == 0) {
+      search.applyBestInsert(o, i, full.getSwapIdx(), ws);
+      score = expected;
+      expect(keptUpToDate(instance, search, o, score, ws, scratch), "applyBestInsert after getInsertScore" + mode);
+    }
+  }
+}
+
+// getSwapDelta against rescoring the swapped ordering from scratch, and the
+// parent sets applySwap keeps against a recomputation.
+void checkSwapDelta(const Instance &instance, Rng &rng) {
+  int n = instance.getN();
+  if (n < 2) {
+    return;
+  }
+  LocalSearch search(instance);
+  ScoringWorkspace ws(n);
+  ScoringWorkspace scratch(n);
+  const std::string mode = instance.usesPositions() ? " with positions" : " with masks";
+  Ordering o = Ordering::randomOrdering(instance, rng);
+  Types::Score score = search.getBestScoreWithParents(o, ws.parents, ws.scores, ws);
+  for (int trial = 0; trial < 100 * n; trial++) {
+    int i = rng.uniform(n);
+    int j = rng.uniform(n - 1);
+    j += j >= i;
+    if (i > j) {
+      std::swap(i, j);
+    }
+    Ordering swapped(o);
+    swapped.swap(i, j);
+    Types::Score expected = search.getBestScore(swapped, scratch) - score;
+    uint64_t hash = o.getHash();
+    Types::Score delta = search.getSwapDelta(o, i, j, ws);
+    expect(delta == expected && o.getHash() == hash, "getSwapDelta" + mode);
+    if (delta <= 0 || rng.uniform(8) == 0) {
+      search.applySwap(o, i, j, ws);
+      score += expected;
+      expect(o.equals(swapped) && keptUpToDate(instance, search, o, score, ws, scratch), "applySwap" + mode);
+    }
+  }
+}
+
+// Calls to expired() until it returns true, giving up past limit.
+int callsToExpire(Deadline &deadline, int limit) {
+  int calls = 1;
+  while (!deadline.expired() && calls <= limit) {
+    calls++;
+  }
+  return calls;
+}
+
+// cancel(), from another thread, must expire running deadlines within one
+// stride of expired() calls, even once the stride has grown to its largest.
+// Cancelling cannot be undone, so this runs after every other check.
+void checkDeadlineCancel() {
+  Deadline never;
+  Deadline later = Deadline::in(3600);
+  int64_t warmUp = Deadline::nowNs() + 20000000;
+  bool running = true;
+  while (Deadline::nowNs() < warmUp) {
+    running = running && callsToExpire(never, 1000) > 1000 && callsToExpire(later, 1000) > 1000;
+  }
+  expect(running && !Deadline::isCancelled(), "Deadline before cancel");
+  std::thread canceller(Deadline::cancel);
+  canceller.join();
+  expect(Deadline::isCancelled() && later.reached(), "Deadline cancel");
+  expect(callsToExpire(never, Deadline::MAX_STRIDE) <= Deadline::MAX_STRIDE, "Deadline never after cancel");
+  expect(callsToExpire(later, Deadline::MAX_STRIDE) <= Deadline::MAX_STRIDE, "Deadline in an hour after cancel");
+}
+
+// Writes a random instance whose parent sets often dominate each other, as
+// the BIC test instances come pruned already. Tokens are separated by
+// spaces or line breaks at random, as the parser does not rely on lines.
+void writeRandomInstance(const std::string &fileName, int n, Rng &rng) {
+  std::ofstream out(fileName.c_str());
+  const char *SEPARATORS[] = {" ", "\n", "  ", " \n "};
+  out << n << "\n";
+  for (int v = 0; v < n; v++) {
+    int m = 1 + rng.uniform(40);
+    out << v << " " << m << "\n";
+    for (int j = 0; j < m; j++) {
+      std::vector<int> parents;
+      // The empty set comes first, so that every ordering is consistent.
+      for (int k = j ? rng.uniform(5) : 0; k > 0; k--) {
+        int p = rng.uniform(n);
+        if (p != v && std::find(parents.begin(), parents.end(), p) == parents.end()) {
+          parents.push_back(p);
+        }
+      }
+      out << "-" << 10 + rng.uniform(8) << "." << rng.uniform(2) * 5 << SEPARATORS[rng.uniform(4)] << parents.size();
+      for (int p : parents) {
+        out << SEPARATORS[rng.uniform(4)] << p;
+      }
+      out << "\n";
+    }
+  }
+}
+
+void checkInstance(const std::string &fileName, Rng &rng) {
+  Instance instance(fileName);
+  std::cout << "Checking " << fileName << " (n = " << instance.getN() << ")" << std::endl;
+  checkParser(fileName);
+  checkKernels(instance, rng);
+  checkIndex(instance, rng);
+  checkImage(fileName);
+  checkPruning(fileName, rng);
+  for (int positionMode = 0; positionMode <= 1; positionMode++) {
+    Instance modal(fileName, positionMode);
+    checkGreedy(modal, rng);
+    checkDepthSort(modal, rng);
+    checkInsert(modal, rng);
+    checkInsertScore(modal, rng);
+    checkSwapDelta(modal, rng);
+  }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    Rng rng(1);
+    checkSmallBitset(rng);
+    checkKernels(rng);
+    checkCrossovers(rng);
+    checkTabuLists(rng);
+    checkParseDouble(rng);
+    checkResultRegister(rng);
+    checkClimbCache(rng);
+    checkMailbox();
+    for (int i = 1; i < argc; i++) {
+      checkInstance(argv[i], rng);
+    }
+    const std::string RANDOM_INSTANCE = "selfcheck.txt";
+    for (int n = 2; n <= 20; n += 6) {
+      writeRandomInstance(RANDOM_INSTANCE, n, rng);
+      checkInstance(RANDOM_INSTANCE, rng);
+    }
+    std::remove(RANDOM_INSTANCE.c_str());
+    checkDeadlineCancel();
+  } catch (const char *error) {
+    std::cerr << "FAILED: " << error << std::endl;
+    failures++;
+  }
+  if (failures) {
+    std::cerr << failures << " checks failed" << std::endl;
+    return 1;
+  }
+  std::cout << "All checks passed" << std::endl;
+  return 0;
+}
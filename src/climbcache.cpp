@@ -0,0 +1,42 @@
+#include "climbcache.h"
+#include "debug.h"
+
+ClimbCache::ClimbCache(int capacity) : mask(0), lookups(0), hits(0) {
+  if (capacity > 0) {
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+      size *= 2;
+    }
+    entries.resize(size);
+    mask = size - 1;
+  }
+}
+
+bool ClimbCache::find(const Ordering &start, SearchResult &climbed) {
+  if (entries.empty()) {
+    return false;
+  }
+  lookups.fetch_add(1, std::memory_order_relaxed);
+  const Entry &entry = entries[start.getHash() & mask];
+  if (!entry.used || !entry.start.equals(start)) {
+    return false;
+  }
+  hits.fetch_add(1, std::memory_order_relaxed);
+  climbed = entry.climbed;
+  return true;
+}
+
+void ClimbCache::insert(const Ordering &start, const SearchResult &climbed) {
+  if (entries.empty()) {
+    return;
+  }
+  Entry &entry = entries[start.getHash() & mask];
+  entry.used = true;
+  entry.start = start;
+  entry.climbed = climbed;
+}
+
+float ClimbCache::getHitRate() const {
+  long numLookups = getLookups();
+  return numLookups == 0 ? 0 : (float)getHits() / numLookups;
+}
@@ -0,0 +1,38 @@
+#ifndef CLIMBCACHE_H
+#define CLIMBCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "ordering.h"
+#include "searchresult.h"
+
+// Climbed results by starting ordering, so that children which repeat an
+// ordering already climbed are not climbed again. Direct mapped on the
+// ordering hash: an insert overwrites whatever shared its slot, which keeps
+// the cache bounded without any bookkeeping. find may run on several threads
+// at once, but not alongside insert.
+class ClimbCache {
+  public:
+    static const int DEFAULT_CAPACITY = 1024;
+    // capacity is rounded up to a power of two; 0 disables the cache.
+    ClimbCache(int capacity);
+    bool find(const Ordering &start, SearchResult &climbed);
+    void insert(const Ordering &start, const SearchResult &climbed);
+    long getLookups() const { return lookups.load(std::memory_order_relaxed); }
+    long getHits() const { return hits.load(std::memory_order_relaxed); }
+    float getHitRate() const;
+  private:
+    struct Entry {
+      Entry() : used(false) {}
+      bool used;
+      Ordering start;
+      SearchResult climbed;
+    };
+    std::vector<Entry> entries;
+    uint64_t mask;
+    std::atomic<long> lookups;
+    std::atomic<long> hits;
+};
+
+#endif /* CLIMBCACHE_H */
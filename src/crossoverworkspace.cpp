@@ -0,0 +1,9 @@
+#include "crossoverworkspace.h"
+#include "debug.h"
+
+CrossoverWorkspace::CrossoverWorkspace(int n) :
+  taken(n), kept(n), bucketStart(2 * n), order(n), n(n) { }
+
+int CrossoverWorkspace::getN() const {
+  return n;
+}
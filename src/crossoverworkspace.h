@@ -0,0 +1,23 @@
+#ifndef CROSSOVERWORKSPACE_H
+#define CROSSOVERWORKSPACE_H
+
+#include <vector>
+
+// Scratch buffers of the crossover operators, sized for n variables once so
+// that building a child allocates nothing.
+class CrossoverWorkspace {
+  public:
+    CrossoverWorkspace(int n);
+    int getN() const;
+    // Per position or per variable flags.
+    std::vector<char> taken;
+    std::vector<char> kept;
+    // Counting sort of crossoverRK: bucket starts by rank sum, and the
+    // variables in bucket order.
+    std::vector<int> bucketStart;
+    std::vector<int> order;
+  private:
+    int n;
+};
+
+#endif /* CROSSOVERWORKSPACE_H */
@@ -0,0 +1,68 @@
+#include "deadline.h"
+#include <time.h>
+#include <cstdint>
+#include "debug.h"
+
+#ifndef CLOCK_MONOTONIC_COARSE
+#define CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC
+#endif
+
+namespace {
+int64_t read(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+}
+
+std::atomic<bool> Deadline::cancelled(false);
+
+Deadline::Deadline() : end(INT64_MAX), lastRead(coarseNowNs()), stride(MAX_STRIDE), countdown(MAX_STRIDE) { }
+
+Deadline::Deadline(int64_t endNs) : end(endNs), lastRead(coarseNowNs()), stride(1), countdown(1) { }
+
+Deadline Deadline::in(double seconds) {
+  return Deadline(nowNs() + (int64_t)(seconds * 1e9));
+}
+
+bool Deadline::reached() const {
+  return isCancelled() || nowNs() >= end;
+}
+
+void Deadline::cancel() {
+  cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool Deadline::isCancelled() {
+  return cancelled.load(std::memory_order_relaxed);
+}
+
+int64_t Deadline::nowNs() {
+  return read(CLOCK_MONOTONIC);
+}
+
+int64_t Deadline::coarseNowNs() {
+  return read(CLOCK_MONOTONIC_COARSE);
+}
+
+// The coarse clock only moves every few milliseconds, so a read that saw no
+// time pass says little; doubling on it and halving on long gaps keeps the
+// reads around CHECK_INTERVAL_NS apart.
+bool Deadline::poll() {
+  int64_t now = coarseNowNs();
+  if (now >= end || isCancelled()) {
+    countdown = 1;
+    return true;
+  }
+  int64_t elapsed = now - lastRead;
+  lastRead = now;
+  if (elapsed < CHECK_INTERVAL_NS / 2) {
+    if (stride < MAX_STRIDE) {
+      stride *= 2;
+    }
+  } else if (elapsed > 2 * CHECK_INTERVAL_NS && stride > 1) {
+    stride /= 2;
+  }
+  countdown = stride;
+  return false;
+}
@@ -0,0 +1,48 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <atomic>
+#include <cstdint>
+
+// Cutoff for search loops, on the monotonic clock so that wall clock jumps
+// cannot move it. expired() is cheap enough to call on every step: it only
+// reads the (coarse) clock every stride calls, and adapts stride so that the
+// clock is read about every CHECK_INTERVAL_NS whatever a step costs.
+// A Deadline holds per-loop state; give each thread its own copy.
+// cancel() expires every deadline at once, e.g. from a signal handler.
+class Deadline {
+  public:
+    static const int64_t CHECK_INTERVAL_NS = 1000000;
+    static const int MAX_STRIDE = 1 << 20;
+    // Never expires.
+    Deadline();
+    // Expires at endNs on the monotonic clock (see nowNs).
+    explicit Deadline(int64_t endNs);
+    // seconds from now.
+    static Deadline in(double seconds);
+    bool expired() {
+      if (--countdown > 0) {
+        return false;
+      }
+      return poll();
+    }
+    // Reads the clock now.
+    bool reached() const;
+    // Async-signal-safe.
+    static void cancel();
+    static bool isCancelled();
+    // CLOCK_MONOTONIC, in nanoseconds.
+    static int64_t nowNs();
+    // CLOCK_MONOTONIC_COARSE, in nanoseconds: same origin as nowNs, ticks in
+    // steps of a few milliseconds but costs a fraction of a precise read.
+    static int64_t coarseNowNs();
+  private:
+    bool poll();
+    static std::atomic<bool> cancelled;
+    int64_t end;
+    int64_t lastRead;
+    int stride;
+    int countdown;
+};
+
+#endif /* DEADLINE_H */
@@ -1,8 +1,8 @@
 #include "fastpivotresult.h"
 #include "debug.h"
 
-FastPivotResult::FastPivotResult(Types::Score score, int swapIdx, Ordering ordering, std::vector<int> parents, std::vector<Types::Score> scores)
-  : score(score), swapIdx(swapIdx), parents(parents), scores(scores), ordering(ordering) { }
+FastPivotResult::FastPivotResult(Types::Score score, int swapIdx)
+  : score(score), swapIdx(swapIdx) { }
   
 int FastPivotResult::getSwapIdx() const {
   return swapIdx;
@@ -12,19 +12,7 @@ Types::Score FastPivotResult::getScore() const {
   return score;
 }
 
-const Ordering &FastPivotResult::getOrdering() {
-  return ordering;
-}
-
 std::ostream& operator<<(std::ostream &os, const FastPivotResult& v) {
-  os << "FastPivotResult(score=" << v.score << ", swapIdx=" << v.swapIdx << ", ordering=" << v.ordering << ")";
+  os << "FastPivotResult(score=" << v.score << ", swapIdx=" << v.swapIdx << ")";
   return os;
 }
-
-const std::vector<Types::Score> &FastPivotResult::getScores() {
-  return scores;
-}
-
-const std::vector<int> &FastPivotResult::getParents() {
-  return parents;
-}
\ No newline at end of file
@@ -1,25 +1,21 @@
 #ifndef FASTPIVOTRESULT_H
 #define FASTPIVOTRESULT_H
 
-#include "ordering.h"
+#include <iostream>
 #include "types.h"
 
+// Score and destination of an insert move. The parent sets after the move
+// are left in the ScoringWorkspace the move was evaluated with.
 class FastPivotResult {
   public:
-    FastPivotResult(Types::Score score, int swapIdx, Ordering ordering, std::vector<int> parents, std::vector<Types::Score> scores);
+    FastPivotResult(Types::Score score, int swapIdx);
     int getSwapIdx() const;
     Types::Score getScore() const;
-    const Ordering &getOrdering();
     friend std::ostream& operator<<(std::ostream &os, const FastPivotResult& v);
-    const std::vector<Types::Score> &getScores();
-    const std::vector<int> &getParents();
     
   private:
     Types::Score score;
     int swapIdx;
-    std::vector<int> parents;
-    std::vector<Types::Score> scores;
-    Ordering ordering;
 };
 
-#endif /* FASTPIVOTRESULT_H */
\ No newline at end of file
+#endif /* FASTPIVOTRESULT_H */
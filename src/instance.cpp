@@ -1,59 +1,286 @@
 #include "instance.h"
-#include <fstream>
+#include "scoreparser.h"
 #include "debug.h"
-#include<boost/dynamic_bitset.hpp>
-
-Instance::Instance(std::string fileName) {
-  const int SCORE_SCALE = -1000000;
-    int countParents = 0;
-  std::ifstream file(fileName);
-  if (file.is_open()) {
-    file >> n;
-    vars.resize(n);
-    for (int i = 0; i < n; i++) {
-      DBG("Working on var: " << i);
-      int varId;
-      int numParents;
-      file >> varId >> numParents;
-      countParents += numParents;
-      DBG(numParents);
-      Variable v(numParents, varId, n);
-
-      for (int j = 0; j < numParents; j++) {
-        double doubleScore;
-        int parentSize;
-        Types::Bitset set(n, 0);
-        std::vector<int> parentsVec;
-        file >> doubleScore >> parentSize;
-        Types::Score score = (Types::Score)(doubleScore * SCORE_SCALE);
-        for (int k = 0; k < parentSize; k++) {
-          int parentVar;
-          file >> parentVar;
-          set[parentVar] = 1;
-          parentsVec.push_back(parentVar);
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include "rng.h"
+#include "workerpool.h"
+
+// positionMode: 1 forces position based consistency checks, 0 forces masks,
+// -1 picks positions for instances with at least POSITION_MODE_MIN_N variables
+// (or keeps the mode an image was compiled with).
+Instance::Instance(std::string fileName, int positionMode, bool prune, int numThreads) : parseBytes(0), parseSeconds(0) {
+  if (InstanceImage::isImage(fileName)) {
+    readImage(fileName, positionMode);
+  } else {
+    readText(fileName, positionMode, prune, numThreads);
+  }
+  buildChildren();
+}
+
+void Instance::readText(const std::string &fileName, int positionMode, bool prune, int numThreads) {
+  WorkerPool pool(numThreads);
+  ScoreParser parser(fileName);
+  parser.parse(pool, store);
+  n = parser.getN();
+  vars.resize(n);
+  positions = positionMode == -1 ? n >= POSITION_MODE_MIN_N : positionMode == 1;
+  std::vector<ScoreParser::Block> &blocks = parser.getBlocks();
+  numRead.assign(n, 0);
+  numPruned.assign(n, 0);
+  pool.run(blocks.size(), [&](int b, int) {
+    ScoreParser::Block &block = blocks[b];
+    numRead[block.varId] = block.count;
+    if (prune) {
+      numPruned[block.varId] = pruneDominated(store.mutableScores() + block.first,
+          store.mutableOffsets() + block.first, store.mutableList(), block.count);
+      block.count -= numPruned[block.varId];
+    }
+  });
+  if (prune) {
+    std::vector<int> begin(blocks.size());
+    std::vector<int> count(blocks.size());
+    for (size_t b = 0; b < blocks.size(); b++) {
+      begin[b] = blocks[b].first;
+      count[b] = blocks[b].count;
+    }
+    store.compact(blocks.size(), begin.data(), count.data());
+    for (size_t b = 0; b < blocks.size(); b++) {
+      blocks[b].first = begin[b];
+    }
+  }
+  store.finish(!positions);
+  for (ScoreParser::Block &block : blocks) {
+    DBG("Working on var: " << block.varId << " with " << block.count << " parent sets");
+    // The index is built over masks' worth of bits, so it is skipped in position mode.
+    int slot = positions ? -1 : index.add(store, block.first, block.count);
+    Variable v(&store, block.first, block.count, block.varId, positions ? NULL : &index, slot);
+    vars[block.varId] = v;
+  }
+  std::vector<int> setBegin(n);
+  std::vector<int> setCount(n);
+  for (int i = 0; i < n; i++) {
+    setBegin[i] = vars[i].getOffset();
+    setCount[i] = vars[i].numParents();
+  }
+  store.buildParentLists(setBegin.data(), setCount.data());
+  parseBytes = parser.getBytes();
+  parseSeconds = parser.getSeconds();
+  DBG("Read in " << store.getSize() << " parent sets.");
+}
+
+// A set is dominated if some proper subset scores no worse: whenever the set
+// is consistent with an ordering so is the subset, so it is never needed.
+// Sets are visited in score order, one group of equal scores at a time, and
+// looked up by enumerating their subsets in a table keyed by an XOR hash of
+// the parents; sets too large to enumerate are compared pairwise.
+int Instance::pruneDominated(Types::Score *scores, int *offsets, int *parents, int m) {
+  const int MAX_ENUMERATED = 12;
+  int maxVar = 0;
+  for (int p = offsets[0]; p < offsets[m]; p++) {
+    maxVar = std::max(maxVar, parents[p]);
+  }
+  auto hashSet = [&](int j) {
+    uint64_t h = 0;
+    for (int p = offsets[j]; p < offsets[j + 1]; p++) {
+      h ^= Rng::hash(parents[p]);
+    }
+    return h;
+  };
+  std::vector<char> marked(maxVar + 1, 0);
+  // True iff the parents of t are all marked and fewer than k.
+  auto properSubset = [&](int t, int k) {
+    if (offsets[t + 1] - offsets[t] >= k) {
+      return false;
+    }
+    for (int p = offsets[t]; p < offsets[t + 1]; p++) {
+      if (!marked[parents[p]]) {
+        return false;
+      }
+    }
+    return true;
+  };
+  std::unordered_multimap<uint64_t, int> seen(m);
+  std::vector<char> keep(m, 1);
+  uint64_t z[MAX_ENUMERATED];
+  for (int g = 0; g < m; ) {
+    int groupEnd = g;
+    while (groupEnd < m && scores[groupEnd] == scores[g]) {
+      seen.insert(std::make_pair(hashSet(groupEnd), groupEnd));
+      groupEnd++;
+    }
+    for (int j = g; j < groupEnd; j++) {
+      const int *set = parents + offsets[j];
+      int k = offsets[j + 1] - offsets[j];
+      for (int i = 0; i < k; i++) {
+        marked[set[i]] = 1;
+      }
+      bool dominated = false;
+      if (k <= MAX_ENUMERATED) {
+        for (int i = 0; i < k; i++) {
+          z[i] = Rng::hash(set[i]);
+        }
+        // Gray code walk over every subset but the set itself.
+        uint64_t h = 0;
+        uint32_t full = (1u << k) - 1;
+        for (uint32_t i = 0; !dominated; ) {
+          if ((i ^ (i >> 1)) != full) {
+            auto range = seen.equal_range(h);
+            for (auto it = range.first; it != range.second && !dominated; ++it) {
+              dominated = properSubset(it->second, k);
+            }
+          }
+          if (++i > full) {
+            break;
+          }
+          h ^= z[__builtin_ctz(i)];
+        }
+      } else {
+        for (int t = 0; t < groupEnd && !dominated; t++) {
+          dominated = properSubset(t, k);
         }
-        ParentSet parentSet(score, set, varId, j, parentsVec);
-        v.addParentSet(parentSet);
       }
-      v.parentSort();
-      v.resetParentIds();
-      v.initParentsWithVar();
-      vars[varId] = v;
-    } 
-  } else {
-    throw "Could not open file";
+      keep[j] = !dominated;
+      for (int i = 0; i < k; i++) {
+        marked[set[i]] = 0;
+      }
+    }
+    g = groupEnd;
+  }
+  // Compact the kept sets in place from the first dropped one on; they stay
+  // in score order. offsets[m] starts the next variable and is not written.
+  int kept = std::find(keep.begin(), keep.end(), 0) - keep.begin();
+  int listEnd = offsets[kept];
+  for (int j = kept + 1; j < m; j++) {
+    if (!keep[j]) {
+      continue;
+    }
+    int begin = offsets[j];
+    int end = offsets[j + 1];
+    scores[kept] = scores[j];
+    listEnd = std::copy(parents + begin, parents + end, parents + listEnd) - parents;
+    offsets[++kept] = listEnd;
+  }
+  return m - kept;
+}
+
+void Instance::readImage(const std::string &fileName, int positionMode) {
+  image.reset(new InstanceImage(fileName));
+  const InstanceImage::Header &header = image->getHeader();
+  n = header.n;
+  // Masks and the index are only in images compiled in mask mode, but a mask
+  // image can still be searched by positions.
+  positions = header.positions || positionMode == 1;
+  if (header.positions && positionMode == 0) {
+    std::cerr << "Instance image was compiled for positions, ignoring -consistency masks" << std::endl;
+  }
+  store.attach(n, header.numSets, !positions, image->get<Types::Score>(InstanceImage::SCORES),
+      image->get<Types::Block>(InstanceImage::MASKS), image->get<int>(InstanceImage::SET_OFFSETS),
+      image->get<int>(InstanceImage::SET_PARENTS));
+  index.attach(header.numSlots, image->get<int>(InstanceImage::INDEX_COUNT),
+      image->get<int>(InstanceImage::INDEX_OFFSETS), image->get<int>(InstanceImage::INDEX_PARENTS),
+      image->get<uint64_t>(InstanceImage::INDEX_BIT_OFFSETS), image->get<Types::Block>(InstanceImage::INDEX_BITS));
+  store.attachParentLists(image->get<int>(InstanceImage::ROW_START), image->get<int>(InstanceImage::ROW_KEYS),
+      image->get<int>(InstanceImage::ROW_OFFSETS), image->get<int>(InstanceImage::ROW_RANKS));
+  vars.resize(n);
+  numRead.assign(n, 0);
+  numPruned.assign(n, 0);
+  const InstanceImage::VarEntry *entries = image->get<InstanceImage::VarEntry>(InstanceImage::VARS);
+  for (int i = 0; i < n; i++) {
+    const InstanceImage::VarEntry &e = entries[i];
+    Variable v(&store, e.offset, e.numParents, e.varId, positions ? NULL : &index, e.indexSlot);
+    vars[e.varId] = v;
+    numRead[e.varId] = e.numParents;
   }
-  DBG("Read in " << countParents << " parent sets.");
+  DBG("Mapped " << header.numSets << " parent sets.");
+}
+
+void Instance::writeImage(const std::string &fileName) const {
+  std::vector<InstanceImage::VarEntry> entries(n);
+  for (int i = 0; i < n; i++) {
+    entries[i].varId = vars[i].getId();
+    entries[i].offset = vars[i].getOffset();
+    entries[i].numParents = vars[i].numParents();
+    entries[i].indexSlot = vars[i].getIndexSlot();
+  }
+  InstanceImage::write(fileName, n, positions, entries.data(), store, index);
 }
 
 int Instance::getN() const {
   return n;
 }
 
+// Text parsing speed in MB/s, or 0 for images.
+double Instance::getParseThroughput() const {
+  return parseSeconds > 0 ? parseBytes / parseSeconds / 1e6 : 0;
+}
+
+bool Instance::usesPositions() const {
+  return positions;
+}
+
 const Variable &Instance::getVar(int i) const {
   return vars[i];
 }
 
+const ParentSetStore &Instance::getStore() const {
+  return store;
+}
+
+const ParentIndex &Instance::getIndex() const {
+  return index;
+}
+
+ParentList Instance::getChildren(int u) const {
+  return ParentList(children.data() + childOffsets[u], children.data() + childOffsets[u + 1]);
+}
+
+// Counts, then lists, each variable once per parent it has in any set.
+void Instance::buildChildren() {
+  std::vector<int> seen(n);
+  std::vector<int> next;
+  childOffsets.assign(n + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    std::fill(seen.begin(), seen.end(), -1);
+    for (int v = 0; v < n; v++) {
+      const Variable &var = vars[v];
+      for (int idx = var.getOffset(); idx < var.getOffset() + var.numParents(); idx++) {
+        for (int u : store.getParents(idx)) {
+          if (seen[u] == v) {
+            continue;
+          }
+          seen[u] = v;
+          if (pass == 0) {
+            childOffsets[u + 1]++;
+          } else {
+            children[next[u]++] = v;
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      std::partial_sum(childOffsets.begin(), childOffsets.end(), childOffsets.begin());
+      children.resize(childOffsets[n]);
+      next.assign(childOffsets.begin(), childOffsets.end() - 1);
+    }
+  }
+}
+
+void Instance::reportPruning(std::ostream &os) const {
+  int totalRead = 0;
+  int totalPruned = 0;
+  for (int i = 0; i < (int)numPruned.size(); i++) {
+    if (numPruned[i]) {
+      os << "Variable " << i << ": pruned " << numPruned[i] << " of " << numRead[i] << " parent sets" << std::endl;
+    }
+    totalRead += numRead[i];
+    totalPruned += numPruned[i];
+  }
+  os << "Pruned " << totalPruned << " of " << totalRead << " parent sets" << std::endl;
+}
+
 std::ostream& operator<<(std::ostream &os, const Instance& I) {
   os << "Printing Instance: " << std::endl;
   for (int i = 0; i < I.n; i++) {
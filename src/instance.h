@@ -1,18 +1,55 @@
 #ifndef INSTANCE_H
 #define INSTANCE_H 
 
+#include <memory>
+#include <string>
 #include <vector>
 #include "variable.h"
+#include "parentsetstore.h"
+#include "parentindex.h"
+#include "instanceimage.h"
+#include "scoreparser.h"
 #include "types.h"
 class Instance {
   public:
-    Instance(std::string fileName);
+    // Above this many variables predecessor masks cost more than they save,
+    // and consistency is checked against ordering positions instead.
+    static const int POSITION_MODE_MIN_N = 1000;
+    // fileName is either a text score file or an image from writeImage.
+    // With prune, dominated parent sets of a text file are dropped on load.
+    // Text files are parsed and pruned on numThreads threads.
+    Instance(std::string fileName, int positionMode = -1, bool prune = false, int numThreads = 1);
+    void writeImage(const std::string &fileName) const;
+    // Per-variable counts of the parent sets dropped by pruning.
+    void reportPruning(std::ostream &os) const;
+    bool usesPositions() const;
+    double getParseThroughput() const;
     int getN() const;
     const Variable &getVar(int i) const;
+    const ParentSetStore &getStore() const;
+    const ParentIndex &getIndex() const;
+    // The variables with a parent set containing u, in increasing order.
+    ParentList getChildren(int u) const;
     friend std::ostream& operator<<(std::ostream &os, const Instance& I);
   private:
+    void readText(const std::string &fileName, int positionMode, bool prune, int numThreads);
+    // Prunes the m sets of a variable at scores, offsets (absolute into parents).
+    static int pruneDominated(Types::Score *scores, int *offsets, int *parents, int m);
+    void readImage(const std::string &fileName, int positionMode);
+    void buildChildren();
     int n;
+    bool positions;
     std::vector<Variable> vars;
+    ParentSetStore store;
+    ParentIndex index;
+    // Backs store and index when loaded from an image.
+    std::unique_ptr<InstanceImage> image;
+    std::vector<int> childOffsets;
+    std::vector<int> children;
+    std::vector<int> numRead;
+    std::vector<int> numPruned;
+    size_t parseBytes;
+    double parseSeconds;
 };
 
 #endif /* INSTANCE_H */
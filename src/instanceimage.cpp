@@ -0,0 +1,105 @@
+#include "instanceimage.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+const char MAGIC[8] = { 'M', 'O', 'B', 'S', 'I', 'M', 'G', '\0' };
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t ALIGN = 64;
+static_assert(sizeof(InstanceImage::Header) % ALIGN == 0, "sections must stay aligned in the mapping");
+
+void appendSection(std::vector<char> &payload, InstanceImage::Header &header, InstanceImage::Section s,
+    const void *src, size_t bytes) {
+  size_t start = (payload.size() + ALIGN - 1) / ALIGN * ALIGN;
+  payload.resize(start + bytes, 0);
+  if (bytes) {
+    std::memcpy(&payload[start], src, bytes);
+  }
+  header.sectionOffset[s] = start;
+  header.sectionBytes[s] = bytes;
+}
+
+}
+
+InstanceImage::InstanceImage(const std::string &fileName) : file(fileName), data(file.data()), header((const Header *)data) {
+  size_t length = file.size();
+  if (length < sizeof(Header)) {
+    throw "Instance image is truncated";
+  }
+  if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw "Not an instance image";
+  } else if (header->byteOrder != BYTE_ORDER_MARK) {
+    throw "Instance image was written on a machine with another byte order";
+  } else if (header->version != VERSION) {
+    throw "Instance image version mismatch, recompile the instance";
+  } else if (sizeof(Header) + header->payloadSize != length) {
+    throw "Instance image is truncated";
+  } else if (checksum(data + sizeof(Header), header->payloadSize) != header->checksum) {
+    throw "Instance image checksum mismatch";
+  }
+  for (int s = 0; s < NUM_SECTIONS; s++) {
+    if (header->sectionOffset[s] + header->sectionBytes[s] > header->payloadSize) {
+      throw "Instance image section out of range";
+    }
+  }
+  DBG("Mapped instance image of " << length << " bytes");
+}
+
+bool InstanceImage::isImage(const std::string &fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void InstanceImage::write(const std::string &fileName, int n, bool positions, const VarEntry *vars,
+    const ParentSetStore &store, const ParentIndex &index) {
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.n = n;
+  header.numSets = store.getSize();
+  header.numSlots = index.getNumSlots();
+  header.positions = positions;
+  size_t numSets = store.getSize();
+  size_t numSlots = index.getNumSlots();
+  std::vector<char> payload;
+  appendSection(payload, header, VARS, vars, n * sizeof(VarEntry));
+  appendSection(payload, header, SCORES, store.scoreData(), numSets * sizeof(Types::Score));
+  appendSection(payload, header, MASKS, store.maskData(),
+      store.hasMasks() ? numSets * store.getNumBlocks() * sizeof(Types::Block) : 0);
+  appendSection(payload, header, SET_OFFSETS, store.offsetData(), (numSets + 1) * sizeof(int));
+  appendSection(payload, header, SET_PARENTS, store.listData(), store.getListSize() * sizeof(int));
+  appendSection(payload, header, INDEX_COUNT, index.countData(), numSlots * sizeof(int));
+  appendSection(payload, header, INDEX_OFFSETS, index.offsetData(), (numSlots + 1) * sizeof(int));
+  appendSection(payload, header, INDEX_PARENTS, index.parentData(), index.offsetData()[numSlots] * sizeof(int));
+  appendSection(payload, header, INDEX_BIT_OFFSETS, index.bitOffsetData(), (numSlots + 1) * sizeof(uint64_t));
+  appendSection(payload, header, INDEX_BITS, index.bitData(), index.bitOffsetData()[numSlots] * sizeof(Types::Block));
+  size_t numRows = store.getNumRows();
+  appendSection(payload, header, ROW_START, store.rowStartData(), (n + 1) * sizeof(int));
+  appendSection(payload, header, ROW_KEYS, store.rowKeyData(), store.denseParentLists() ? 0 : numRows * sizeof(int));
+  appendSection(payload, header, ROW_OFFSETS, store.rowOffsetData(), (numRows + 1) * sizeof(int));
+  appendSection(payload, header, ROW_RANKS, store.rowRankData(), store.rowOffsetData()[numRows] * sizeof(int));
+  payload.resize((payload.size() + ALIGN - 1) / ALIGN * ALIGN, 0);
+  header.payloadSize = payload.size();
+  header.checksum = checksum(payload.data(), payload.size());
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.write((const char *)&header, sizeof(header)) || !file.write(payload.data(), payload.size())) {
+    throw "Could not write instance image";
+  }
+}
+
+// FNV-1a over 64-bit words; the payload is padded to a multiple of ALIGN.
+uint64_t InstanceImage::checksum(const char *payload, size_t bytes) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, payload + i, sizeof(word));
+    h = (h ^ word) * 1099511628211ULL;
+  }
+  return h;
+}
@@ -0,0 +1,80 @@
+#ifndef INSTANCEIMAGE_H
+#define INSTANCEIMAGE_H
+
+#include <cstdint>
+#include <string>
+#include "types.h"
+#include "parentsetstore.h"
+#include "parentindex.h"
+#include "mappedfile.h"
+
+// Binary image of a preprocessed instance, written by `search --compile-instance`.
+// The image holds the score-sorted parent sets (scores, masks, parent lists
+// and the per-parent rank lists), the per-variable ParentIndex and the
+// variable table, each in its
+// own 64-byte aligned section, in native byte order. Loading maps the file
+// read-only and the store and index read the sections in place.
+// Layout: Header, then the payload covered by the checksum.
+class InstanceImage {
+  public:
+    static const uint32_t VERSION = 2;
+    enum Section {
+      VARS,
+      SCORES,
+      MASKS,
+      SET_OFFSETS,
+      SET_PARENTS,
+      INDEX_COUNT,
+      INDEX_OFFSETS,
+      INDEX_PARENTS,
+      INDEX_BIT_OFFSETS,
+      INDEX_BITS,
+      ROW_START,
+      ROW_KEYS,
+      ROW_OFFSETS,
+      ROW_RANKS,
+      NUM_SECTIONS
+    };
+    // One row of the VARS section.
+    struct VarEntry {
+      int32_t varId;
+      int32_t offset;
+      int32_t numParents;
+      int32_t indexSlot;
+    };
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byteOrder;
+      int32_t n;
+      int32_t numSets;
+      int32_t numSlots;
+      uint32_t positions;
+      uint64_t payloadSize;
+      uint64_t checksum;
+      uint64_t sectionOffset[NUM_SECTIONS];
+      uint64_t sectionBytes[NUM_SECTIONS];
+      uint64_t reserved[14];
+    };
+
+    // Maps fileName and validates its header and checksum; throws on failure.
+    InstanceImage(const std::string &fileName);
+    static bool isImage(const std::string &fileName);
+    // Builds the image in memory and writes it in one go.
+    static void write(const std::string &fileName, int n, bool positions, const VarEntry *vars,
+        const ParentSetStore &store, const ParentIndex &index);
+    const Header &getHeader() const { return *header; }
+    template<class T> const T *get(Section s) const {
+      return reinterpret_cast<const T *>(data + sizeof(Header) + header->sectionOffset[s]);
+    }
+    size_t getBytes() const { return file.size(); }
+  private:
+    InstanceImage(const InstanceImage &);
+    InstanceImage &operator=(const InstanceImage &);
+    static uint64_t checksum(const char *payload, size_t bytes);
+    MappedFile file;
+    const char *data;
+    const Header *header;
+};
+
+#endif /* INSTANCEIMAGE_H */
@@ -1,6 +1,7 @@
 #include "localsearch.h"
 #include "debug.h"
 #include <numeric>
+#include <algorithm>
 #include <utility>
 #include <deque>
 #include <cmath>
@@ -8,60 +9,81 @@
 #include "util.h"
 #include "movetabulist.h"
 #include "swaptabulist.h"
+#include "allocationcounter.h"
+#include "pivotqueue.h"
+#include "workerpool.h"
+#include "deadline.h"
+#include "mailbox.h"
+#include <memory>
+#include <mutex>
+#include <thread>
 
-LocalSearch::LocalSearch(const Instance &instance) : instance(instance) { 
+LocalSearch::LocalSearch(const Instance &instance, uint64_t seed) : instance(instance), rng(seed) {
 }
 
-const ParentSet &LocalSearch::bestParent(const Ordering &ordering, const Types::Bitset pred, int idx) const {
+ParentSet LocalSearch::bestParent(const Ordering &ordering, const Types::Bitset &pred, int idx) const {
   int current = ordering.get(idx);
   const Variable &v = instance.getVar(current);
+  if (instance.usesPositions()) {
+    return bestParentVarAt(ordering, idx, v);
+  }
   return bestParentVar(pred, v);
 }
 
-const ParentSet &LocalSearch::bestParentVar(const Types::Bitset pred, const Variable &v) const {
-  int numParents = v.numParents();
-  for (int i = 0; i < numParents; i++) {
-    const ParentSet &p = v.getParent(i);
-    if (p.subsetOf(pred)) {
-      return p;
-    }
+ParentSet LocalSearch::bestParentVar(const Types::Bitset &pred, const Variable &v) const {
+  int i = v.firstConsistent(pred);
+  if (i == -1) {
+    //DBG("PARENT SET NOT FOUND");
+    return v.getParent(0); //Should never happen in THeory
   }
-  //DBG("PARENT SET NOT FOUND");
-  return v.getParent(0); //Should never happen in THeory
+  return v.getParent(i);
 }
 
 
-// Sketchy to use pointeres but we have to use null.. it's possible there is no Var at all.
-const ParentSet *LocalSearch::bestParentVarWithParent(const Types::Bitset pred, const Variable &a, const Variable &b, const Types::Score orig) const {
-  //const std::vector<int> &candidates = a.parentsWithVarId(b.getId());
-  auto candidates_iter = a.parentsWithVarId(b.getId());
-  if (candidates_iter == a.parentsWithVar.end()) return NULL;
-  const std::vector<int> &candidates = candidates_iter->second;
-  int n = candidates.size();
-  for (int i = 0; i < n; i++) {
-    const ParentSet &p = a.getParent(candidates[i]);
-    if (p.getScore() >= orig) break;
-    if (p.subsetOf(pred)) {
-      return &p;
-    }
-  }
-  //DBG("PARENT SET NOT FOUND");
-  return NULL; //Coult happen
+// Returns the id of the best parent set of a containing b that is consistent with pred and scores better than orig.
+// It's possible there is no such set at all, in which case -1 is returned.
+int LocalSearch::bestParentVarWithParent(const Types::Bitset &pred, const Variable &a, const Variable &b, const Types::Score orig) const {
+  // Sets are in score order, so only those ranked before the first set scoring orig or worse matter.
+  const Types::Score *scores = a.getScores();
+  int limit = std::lower_bound(scores, scores + a.numParents(), orig) - scores;
+  return a.firstConsistentWithParent(pred, b.getId(), limit);
 }
 
 
-Types::Bitset LocalSearch::getPred(const Ordering &ordering, int idx) const {
-  int n = instance.getN();
-  Types::Bitset pred(n, 0);
+// In position mode the predecessors of idx are read off ordering's positions, so
+// callers may keep updating pred but nothing reads it.
+ParentSet LocalSearch::bestParentVarAt(const Ordering &ordering, int idx, const Variable &v) const {
+  int i = v.firstConsistentAt(ordering.getPositions(), idx, -1);
+  return v.getParent(i == -1 ? 0 : i);
+}
+
+int LocalSearch::bestParentVarWithParentAt(const Ordering &ordering, int idx, const Variable &a, const Variable &b, const Types::Score orig) const {
+  const Types::Score *scores = a.getScores();
+  int limit = std::lower_bound(scores, scores + a.numParents(), orig) - scores;
+  return a.firstConsistentWithParentAt(ordering.getPositions(), idx, b.getId(), limit);
+}
+
+// Score of the best set of var containing parent, or SCORE_MAX.
+Types::Score LocalSearch::bestWithParent(int var, int parent) const {
+  ParentList ranks = instance.getStore().withParent(var, parent);
+  return ranks.size() == 0 ? Types::SCORE_MAX : instance.getVar(var).getScores()[ranks[0]];
+}
+
+// Sets pred to the variables before idx in ordering.
+void LocalSearch::getPred(const Ordering &ordering, int idx, Types::Bitset &pred) const {
+  pred.reset();
+  if (instance.usesPositions()) {
+    return;
+  }
   for (int i = 0; i < idx; i++) {
     pred[ordering.get(i)] = 1;
   }
-  return pred;
 }
 
-Types::Score LocalSearch::getBestScore(const Ordering &ordering) const {
+Types::Score LocalSearch::getBestScore(const Ordering &ordering, ScoringWorkspace &ws) const {
   int n = instance.getN();
-  Types::Bitset pred(n, 0);
+  Types::Bitset &pred = ws.pred;
+  pred.reset();
   Types::Score score = 0;
   for (int i = 0; i < n; i++) {
     const ParentSet &p = bestParent(ordering, pred, i);
@@ -72,9 +94,10 @@ Types::Score LocalSearch::getBestScore(const Ordering &ordering) const {
 }
 
 // New code
-Types::Score LocalSearch::getBestScoreWithParents(const Ordering &ordering, std::vector<int> &parents, std::vector<Types::Score> &scores) const {
+Types::Score LocalSearch::getBestScoreWithParents(const Ordering &ordering, std::vector<int> &parents, std::vector<Types::Score> &scores, ScoringWorkspace &ws) const {
   int n = instance.getN();
-  Types::Bitset pred(n, 0);
+  Types::Bitset &pred = ws.pred;
+  pred.reset();
   Types::Score score = 0;
   for (int i = 0; i < n; i++) {
     const ParentSet &p = bestParent(ordering, pred, i);
@@ -86,10 +109,10 @@ Types::Score LocalSearch::getBestScoreWithParents(const Ordering &ordering, std:
   return score;
 }
 
-Types::Score LocalSearch::findBestScoreRange(const Ordering &o, int start, int end) {
-  int n = instance.getN();
+Types::Score LocalSearch::findBestScoreRange(const Ordering &o, int start, int end, ScoringWorkspace &ws) {
   Types::Score curScore = 0;
-  Types::Bitset used(n, 0);
+  Types::Bitset &used = ws.pred;
+  used.reset();
   for (int i = 0; i < start; i++) {
     used[o.get(i)] = 1;
   }
@@ -105,22 +128,24 @@ Types::Score LocalSearch::findBestScoreRange(const Ordering &o, int start, int e
 SwapResult LocalSearch::findBestScoreSwap(
 const Ordering &ordering, int i, const std::vector<int> &parents, Types::Bitset &pred)
 {
-  int n = instance.getN();
+  return findBestScoreSwap(ordering, i, parents[ordering.get(i)], parents[ordering.get(i + 1)], pred);
+}
+
+SwapResult LocalSearch::findBestScoreSwap(const Ordering &ordering, int i, int aParent, int bParent, Types::Bitset &pred) {
   int j = i + 1;
-  Types::Score curScore = 0;
   int aVarId = ordering.get(i);
   int bVarId = ordering.get(j);
   const Variable &a = instance.getVar(aVarId);
   const Variable &b = instance.getVar(bVarId);
-  const ParentSet &b_0 = b.getParent(parents[bVarId]);
-  const ParentSet &a_0 = a.getParent(parents[aVarId]);
+  const ParentSet &b_0 = b.getParent(bParent);
+  const ParentSet &a_0 = a.getParent(aParent);
   int aNewParentSetId = -1;
   int bNewParentSetId = -1;
   Types::Score newBScore = -1LL;
   Types::Score newAScore = -1LL;
   if (b_0.hasElement(aVarId)) {
     
-    const ParentSet &bNew = bestParentVar(pred, b);
+    const ParentSet &bNew = instance.usesPositions() ? bestParentVarAt(ordering, i, b) : bestParentVar(pred, b);
     newBScore = bNew.getScore();
     bNewParentSetId = bNew.getId();
     //DBG("Collision detected, found new parent set " << bNew.getId() << " for " << bVarId);
@@ -132,15 +157,17 @@ const Ordering &ordering, int i, const std::vector<int> &parents, Types::Bitset
   pred[bVarId] = 1;
 
   if (a_0.getId() != 0) {
-    const ParentSet *aNew = bestParentVarWithParent(pred, a, b, a_0.getScore());
-    if (aNew == NULL || aNew->getScore() > a_0.getScore()) {
+    int aNewId = instance.usesPositions() ? bestParentVarWithParentAt(ordering, i, a, b, a_0.getScore())
+      : bestParentVarWithParent(pred, a, b, a_0.getScore());
+    if (aNewId == -1 || a.getParent(aNewId).getScore() > a_0.getScore()) {
       //DBG("No new parent sets or none improving for " << aVarId);
       newAScore = a_0.getScore();
       aNewParentSetId = a_0.getId();
     } else {
-      //DBG("Found improving parent set " << aNew->getId() << " including " << bVarId << " for " << aVarId);
-      newAScore = aNew->getScore();
-      aNewParentSetId = aNew->getId();
+      //DBG("Found improving parent set " << aNewId << " including " << bVarId << " for " << aVarId);
+      const ParentSet aNew = a.getParent(aNewId);
+      newAScore = aNew.getScore();
+      aNewParentSetId = aNew.getId();
     }
   } else {
     //DBG("Optimal parent for " << aVarId << " already found.");
@@ -159,7 +186,7 @@ SearchResult LocalSearch::simulatedAnnealing(double initTemp, int numSteps, floa
   rr.set();
   SearchResult best(bestScore, Ordering(n));
   do {
-    Ordering o = Ordering::greedyOrdering(instance);
+    Ordering o = Ordering::greedyOrdering(instance, rng);
     SearchResult sr(Types::SCORE_MAX, o);
     if (neighbour == Neighbours::INSERT) {
       sr = simulatedAnnealingStepsInsert(o, initTemp, numSteps, decay, timeLimit, rr);
@@ -169,117 +196,169 @@ SearchResult LocalSearch::simulatedAnnealing(double initTemp, int numSteps, floa
     if (sr.getScore() < best.getScore()) {
       best = sr;
     }
-  } while (!Util::isOpt(best, opt) && rr.check() < timeLimit);
+  } while (!Util::isOpt(best, opt) && !rr.deadline(timeLimit).reached());
 
   return best;
 }
 
 SearchResult LocalSearch::simulatedAnnealingStepsSwap(Ordering &o, double initTemp, int maxSteps, float decay, float timeLimit, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(timeLimit);
   int numSteps = 0;
   int n = instance.getN();
-  Types::Score curScore = getBestScore(o);
-  double temp = initTemp;
+  ScoringWorkspace ws(n);
   Ordering current(o);
+  Types::Score curScore = getBestScoreWithParents(current, ws.parents, ws.scores, ws);
+  double temp = initTemp;
   DBG("Anneal(" << initTemp << ", " << maxSteps << ", " << decay << ")");
-  while (numSteps < maxSteps && rr.check() < timeLimit) {
+  while (numSteps < maxSteps && !deadline.expired()) {
     //DBG(curScore);
     bool accept = false;
-    std::pair<int, int> indices = Util::getUniquePair(n);
+    std::pair<int, int> indices = Util::getUniquePair(n, rng);
     int i = indices.first;
     int j = indices.second;
-    Ordering inserted(current);
-    inserted.swap(i, j);
     if (i > j) {
       std::swap(i, j);
     }
-    Types::Score cost_0 = findBestScoreRange(current, i, j);
-    Types::Score cost = findBestScoreRange(inserted, i, j);
-    Types::Score delta = cost - cost_0;
+    Types::Score delta = getSwapDelta(current, i, j, ws);
     if (delta < 0) {
       accept = true;
     } else {
       double pAccept = pow(2.716, (double) -delta / temp);
-      double r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+      double r = rng.real();
       accept = r <= pAccept;
       if (r <= pAccept) {
         //DBG("acceping worse step (" << i << ", " << j << ") OldScore: " << cost_0 << " New: " << cost << " Paccept: " << pAccept);
       }
     }
     if (accept) {
-      current = inserted;
-      curScore += cost - cost_0;
+      applySwap(current, i, j, ws);
+      curScore += delta;
     }
     numSteps += 1;
     temp *= decay;
   }
-  DBG(getBestScore(current));
-  return SearchResult(getBestScore(current), current);
+  DBG(getBestScore(current, ws));
+  return SearchResult(getBestScore(current, ws), current);
+}
+
+// Change in score from swapping positions i < j, given the parent sets in
+// ws.parents. Moved to i, b only loses predecessors, so it needs a new set
+// only if its set has a parent at or after i; moved to j, a only gains
+// predecessors and is looked up again. The variables between lose a and gain
+// b, so they need a new set only if theirs contains a or if some better set
+// contains b. The new sets are recorded in ws.passedParents and
+// ws.passedScores for applySwap, and ordering is left unchanged.
+Types::Score LocalSearch::getSwapDelta(Ordering &ordering, int i, int j, ScoringWorkspace &ws) {
+  const std::vector<int> &parents = ws.parents;
+  const std::vector<Types::Score> &scores = ws.scores;
+  std::vector<int> &passedParents = ws.passedParents;
+  std::vector<Types::Score> &passedScores = ws.passedScores;
+  Types::Bitset &pred = ws.pred;
+  int aVarId = ordering.get(i);
+  int bVarId = ordering.get(j);
+  ordering.swapUnhashed(i, j);
+  getPred(ordering, i, pred);
+  Types::Score delta = 0;
+  for (int k = i; k <= j; k++) {
+    int varId = ordering.get(k);
+    const Variable &v = instance.getVar(varId);
+    bool stale;
+    if (k == i) {
+      stale = false;
+      for (int parent : v.getParent(parents[varId]).getParentsVec()) {
+        stale = stale || ordering.getPosition(parent) >= i;
+      }
+    } else if (k == j) {
+      stale = true;
+    } else {
+      stale = v.getParent(parents[varId]).hasElement(aVarId) || bestWithParent(varId, bVarId) < scores[varId];
+    }
+    if (stale) {
+      const ParentSet &p = bestParent(ordering, pred, k);
+      passedParents[varId] = p.getId();
+      passedScores[varId] = p.getScore();
+    } else {
+      passedParents[varId] = parents[varId];
+      passedScores[varId] = scores[varId];
+    }
+    delta += passedScores[varId] - scores[varId];
+    pred[varId] = 1;
+  }
+  ordering.swapUnhashed(i, j);
+  return delta;
+}
+
+// Applies the swap last scored by getSwapDelta.
+void LocalSearch::applySwap(Ordering &ordering, int i, int j, ScoringWorkspace &ws) const {
+  for (int k = i; k <= j; k++) {
+    int varId = ordering.get(k);
+    ws.parents[varId] = ws.passedParents[varId];
+    ws.scores[varId] = ws.passedScores[varId];
+  }
+  ordering.swap(i, j);
 }
 
 SearchResult LocalSearch::simulatedAnnealingStepsInsert(Ordering &o, double initTemp, int maxSteps, float decay, float timeLimit, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(timeLimit);
   int numSteps = 0;
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
+  ScoringWorkspace ws(n);
   Ordering current(o);
-  Types::Score curScore = getBestScoreWithParents(current, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(current, ws.parents, ws.scores, ws);
   double temp = initTemp;
   DBG("Anneal(" << initTemp << ", " << maxSteps << ", " << decay << ")");
-  while (numSteps < maxSteps && rr.check() < timeLimit) {
+  while (numSteps < maxSteps && !deadline.expired()) {
     //DBG(curScore);
-    bool accept = false;
-    std::pair<int, int> indices = Util::getUniquePair(n);
+    std::pair<int, int> indices = Util::getUniquePair(n, rng);
     int i = indices.first;
     int j = indices.second;
-    FastPivotResult newResult = getInsertScore(current, i, j, curScore, parents, scores);
-    Types::Score delta = newResult.getScore()  - curScore;
-    if (delta < 0) {
-      accept = true;
-    } else {
-      double pAccept = pow(2.716, (double) -delta / temp);
-      double r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-      accept = r <= pAccept;
-      if (r <= pAccept) {
-        //DBG("acceping worse step (" << i << ", " << j << ") OldScore: " << cost_0 << " New: " << cost << " Paccept: " << pAccept);
-      }
-    }
-    if (accept) {
-      current = newResult.getOrdering();
+    // A move is accepted iff r <= 2.716^(-delta / temp), that is iff delta is
+    // at most maxDelta, so getInsertScore may give up on it early.
+    double r = rng.real();
+    double bound = r > 0 ? -temp * log(r) / log(2.716) : HUGE_VAL;
+    Types::Score maxDelta = bound < 9e18 ? (Types::Score)bound : Types::SCORE_MAX;
+    FastPivotResult newResult = getInsertScore(current, i, j, curScore, ws, maxDelta);
+    if (newResult.getScore() - curScore <= maxDelta) {
+      applyBestInsert(current, i, newResult.getSwapIdx(), ws);
       curScore = newResult.getScore();
-      parents = newResult.getParents();
-      scores = newResult.getScores();
     }
     numSteps += 1;
     temp *= decay;
   }
-  DBG(getBestScore(current));
-  return SearchResult(getBestScore(current), current);
+  DBG(getBestScore(current, ws));
+  return SearchResult(getBestScore(current, ws), current);
 }
 
 SearchResult LocalSearch::kollerSearch(Ordering &o, int listSize, float timeLimit, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(timeLimit);
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
+  ScoringWorkspace ws(n);
+  std::vector<int> &parents = ws.parents;
+  std::vector<Types::Score> &scores = ws.scores;
   int maxNonImprovingSteps = listSize;
   int nonImprovingSteps = 0;
   Ordering current(o);
-  Types::Score curScore = getBestScoreWithParents(current, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(current, parents, scores, ws);
 
   Ordering bestSeenOrdering(o);
   Types::Score bestSeenOrderingScore = curScore;
-  SwapTabuList stl(listSize);
+  SwapTabuList stl(listSize, n);
+  std::vector<int> plateauMoves;
+  std::vector<SwapResult> plateauResults;
   //DBG("TEST");
   //while (rr.check() < timeLimit && nonImprovingSteps < maxNonImprovingSteps) { // Out for now
-  while (rr.check() < timeLimit && nonImprovingSteps < maxNonImprovingSteps) {
-    Types::Bitset pred(n, 0);
+  while (!deadline.expired() && nonImprovingSteps < maxNonImprovingSteps) {
+    Types::Bitset &pred = ws.pred;
+    pred.reset();
     DBG("Cur Score: " << curScore);
     Types::Score bestDelta = Types::SCORE_MAX;
     int bestSwap = -1;
     SwapResult bestSwapResult(Types::SCORE_MAX, Types::SCORE_MAX, -1, -1);
-    std::vector<int> plateauMoves;
-    std::vector<SwapResult> plateauResults;
+    plateauMoves.clear();
+    plateauResults.clear();
     for (int i = 0; i < n - 1; i++) {
       if (stl.contains(current.get(i), current.get(i+1))) {
+        pred[current.get(i)] = 1;
         continue;
       }
       Types::Score cost_0 = scores[current.get(i)] + scores[current.get(i+1)];
@@ -303,7 +382,7 @@ SearchResult LocalSearch::kollerSearch(Ordering &o, int listSize, float timeLimi
     }
     if (bestSwap != -1) {
       if (bestDelta == 0) {
-        int plateauIdx = rand() % plateauMoves.size();
+        int plateauIdx = rng.uniform(plateauMoves.size());
         bestSwap = plateauMoves[plateauIdx];
         bestSwapResult = plateauResults[plateauIdx];
       }
@@ -334,29 +413,35 @@ SearchResult LocalSearch::kollerSearch(Ordering &o, int listSize, float timeLimi
     //stl.print();
   }
   DBG("DONE");
-  return SearchResult(getBestScore(bestSeenOrdering), bestSeenOrdering);
+  return SearchResult(getBestScore(bestSeenOrdering, ws), bestSeenOrdering);
 }
 
 SearchResult LocalSearch::kollerSearchV2(Ordering &o, int listSize, float timeLimit, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(timeLimit);
   int n = instance.getN();
-  Types::Score curScore = getBestScore(o);
+  ScoringWorkspace ws(n);
+  Types::Score curScore = getBestScore(o, ws);
   Ordering current(o);
   int maxNonImprovingSteps = listSize;
   int nonImprovingSteps = 0;
   TabuList tl(listSize);
   Ordering bestSeenOrdering(o);
   Types::Score bestSeenOrderingScore = curScore;
-  while (rr.check() < timeLimit && nonImprovingSteps < maxNonImprovingSteps) {
+  while (!deadline.expired() && nonImprovingSteps < maxNonImprovingSteps) {
     DBG("Cur Score: " << curScore);
     Types::Score bestDelta = Types::SCORE_MAX;
     int bestSwap = -1;
     for (int i = 0; i < n - 1; i++) {
-
-      Types::Score cost_0 = findBestScoreRange(current, i, i+1);
-      Ordering swapped(current);
-      if (tl.contains(swapped)) continue;
-      swapped.swap(i, i+1);
-      Types::Score cost = findBestScoreRange(swapped, i, i+1);
+      // The neighbour is tried in place; the tabu test only needs its hash
+      // unless that matches.
+      Types::Score cost_0 = findBestScoreRange(current, i, i+1, ws);
+      current.swap(i, i+1);
+      if (tl.contains(current)) {
+        current.swap(i, i+1);
+        continue;
+      }
+      Types::Score cost = findBestScoreRange(current, i, i+1, ws);
+      current.swap(i, i+1);
       Types::Score delta = cost - cost_0;
       //DBG("Delta(" << i << "): " << delta);
       if (delta < bestDelta) {
@@ -381,184 +466,205 @@ SearchResult LocalSearch::kollerSearchV2(Ordering &o, int listSize, float timeLi
     //DBG(current);
     //stl.print();
   }
-  return SearchResult(getBestScore(bestSeenOrdering), bestSeenOrdering);
+  return SearchResult(getBestScore(bestSeenOrdering, ws), bestSeenOrdering);
 }
 SearchResult LocalSearch::kollerSearchRestarts(int listSize, float timeLimit, Types::Score opt, ResultRegister &rr) {
    int n = instance.getN();
    Types::Score bestScore = Types::SCORE_MAX;
    SearchResult best(bestScore, Ordering(n));
    do {
-     Ordering o = Ordering::randomOrdering(instance);
+     Ordering o = Ordering::randomOrdering(instance, rng);
      SearchResult cur = kollerSearch(o, listSize, timeLimit, rr);
      DBG(cur);
      if (cur.getScore() < best.getScore()) {
        best = cur;
      }
-   } while (!Util::isOpt(best, opt) && rr.check() < timeLimit);
+   } while (!Util::isOpt(best, opt) && !rr.deadline(timeLimit).reached());
    return best; 
 }
 
-FastPivotResult LocalSearch::getInsertScore(Ordering o, int pivot, int dest, Types::Score initScore, std::vector<int> parents, std::vector<Types::Score> scores) {
-  int n = instance.getN();
+// Score of moving the variable at pivot to dest (to just before dest when
+// moving forward), by adjacent swaps from the parent sets in ws.parents. The
+// swaps are walked in place on ordering, which is restored before returning,
+// and the parent sets they lead to are recorded in ws as by getBestInsertFast,
+// so that applyBestInsert can apply the move to the returned index.
+// Moving forward, the passed variables lose a predecessor and only the pivot
+// can improve, to no better than its best set containing a variable still to
+// be passed. Moving backward, only the passed variables can improve, each to
+// no better than its best set containing the pivot. Once that cannot bring
+// the move within maxDelta of initScore, the walk stops and returns a lower
+// bound instead.
+FastPivotResult LocalSearch::getInsertScore(Ordering &ordering, int pivot, int dest, Types::Score initScore, ScoringWorkspace &ws, Types::Score maxDelta) {
+  const std::vector<int> &parents = ws.parents;
+  const std::vector<Types::Score> &scores = ws.scores;
+  std::vector<int> &passedParents = ws.passedParents;
+  std::vector<Types::Score> &passedScores = ws.passedScores;
+  Types::Bitset &pred = ws.pred;
+  getPred(ordering, pivot, pred);
+  int pivotVarId = ordering.get(pivot);
+  int pivotParent = parents[pivotVarId];
+  Types::Score pivotScore = scores[pivotVarId];
   Types::Score curScore = initScore;
-  Types::Bitset pred = getPred(o, pivot);
-  if (pivot < dest) {
-    for (int i = pivot; i + 1 < dest; i++) {
-      Types::Score oldScore = scores[o.get(i)] + scores[o.get(i+1)];
-      SwapResult sr = findBestScoreSwap(o, i, parents, pred);
-      o.swap(i, i+1);
-      pred[o.get(i)] = 1;
-      std::pair<Types::Score, Types::Score> newParentScores = sr.getScores();
-      scores[o.get(i)] = newParentScores.first;
-      scores[o.get(i + 1)] = newParentScores.second;
-      std::pair<int, int> newParentSets = sr.getParentSets();
-      parents[o.get(i)] = newParentSets.first;
-      parents[o.get(i + 1)] = newParentSets.second;
-      Types::Score newScore = sr.getScore();
-      curScore += newScore - oldScore;
+  int to = pivot < dest ? dest - 1 : dest;
+  std::vector<Types::Score> &reach = ws.reach;
+  if (maxDelta != Types::SCORE_MAX) {
+    Types::Score best = Types::SCORE_MAX;
+    for (int k = to; k > pivot; k--) {
+      best = std::min(best, bestWithParent(pivotVarId, ordering.get(k)));
+      reach[k] = best;
     }
-  } else {
-    for (int i = pivot - 1; i >= dest; i--) {
-      pred[o.get(i)] = 0;
-      Types::Score oldScore = scores[o.get(i)] + scores[o.get(i+1)];
-      SwapResult sr = findBestScoreSwap(o, i, parents, pred);
-      o.swap(i, i+1);
-      std::pair<Types::Score, Types::Score> newParentScores = sr.getScores();
-      scores[o.get(i)] = newParentScores.first;
-      scores[o.get(i + 1)] = newParentScores.second;
-      std::pair<int, int> newParentSets = sr.getParentSets();
-      parents[o.get(i)] = newParentSets.first;
-      parents[o.get(i + 1)] = newParentSets.second;
-      Types::Score newScore = sr.getScore();
-      curScore += newScore - oldScore;
+  }
+  int i = pivot;
+  for (; i < to; i++) {
+    if (maxDelta != Types::SCORE_MAX) {
+      Types::Score floor = std::min(pivotScore, reach[i + 1]);
+      if (curScore - pivotScore + floor - initScore > maxDelta) {
+        ordering.insertUnhashed(i, pivot);
+        return FastPivotResult(curScore - pivotScore + floor, -1);
+      }
+    }
+    int passedVarId = ordering.get(i + 1);
+    SwapResult sr = findBestScoreSwap(ordering, i, pivotParent, parents[passedVarId], pred);
+    Types::Score oldScore = pivotScore + scores[passedVarId];
+    ordering.swapUnhashed(i, i + 1);
+    pred[passedVarId] = 1;
+    passedParents[passedVarId] = sr.getParentSets().first;
+    passedScores[passedVarId] = sr.getScores().first;
+    pivotParent = sr.getParentSets().second;
+    pivotScore = sr.getScores().second;
+    curScore += sr.getScore() - oldScore;
+  }
+  Types::Score gain = 0;
+  if (maxDelta != Types::SCORE_MAX) {
+    for (int k = to; k < i; k++) {
+      int var = ordering.get(k);
+      gain += std::max((Types::Score)0, scores[var] - bestWithParent(var, pivotVarId));
+    }
+  }
+  for (; i > to; i--) {
+    if (curScore - gain - initScore > maxDelta) {
+      ordering.insertUnhashed(i, pivot);
+      return FastPivotResult(curScore - gain, -1);
+    }
+    int passedVarId = ordering.get(i - 1);
+    if (maxDelta != Types::SCORE_MAX) {
+      gain -= std::max((Types::Score)0, scores[passedVarId] - bestWithParent(passedVarId, pivotVarId));
     }
+    pred[passedVarId] = 0;
+    SwapResult sr = findBestScoreSwap(ordering, i - 1, parents[passedVarId], pivotParent, pred);
+    Types::Score oldScore = scores[passedVarId] + pivotScore;
+    ordering.swapUnhashed(i - 1, i);
+    passedParents[passedVarId] = sr.getParentSets().second;
+    passedScores[passedVarId] = sr.getScores().second;
+    pivotParent = sr.getParentSets().first;
+    pivotScore = sr.getScores().first;
+    curScore += sr.getScore() - oldScore;
   }
-  return FastPivotResult(curScore, -1, o, parents, scores);
+  ws.firstScore[to] = std::make_pair(pivotScore, pivotParent);
+  ordering.insertUnhashed(to, pivot);
+  return FastPivotResult(curScore, to);
 }
 
 
 // This code....
-FastPivotResult LocalSearch::getBestInsertFast(const Ordering &ordering, int pivot, Types::Score initScore, const std::vector<int> &parents, const std::vector<Types::Score> &scores) {
+// Best destination for the variable at pivot given the parent sets in
+// ws.parents. The swaps are tried in place on ordering, which is restored
+// before returning, and only the parent sets they lead to are recorded in ws,
+// so that applyBestInsert can replay the chosen move.
+FastPivotResult LocalSearch::getBestInsertFast(Ordering &ordering, int pivot, Types::Score initScore, ScoringWorkspace &ws, Deadline &deadline) {
   //DBG("START");
   int n = instance.getN();
-  Types::Bitset forwardPred = getPred(ordering, pivot);
-  Types::Bitset backwardPred(forwardPred);
-  /*
-  if (pivot > 0) {
-    backwardPred[ordering.get(pivot - 1)] = 0;
-  }
-  */
-  std::vector<int> forwardParents(parents);
-  std::vector<int> backwardParents(parents);
-  std::vector<Types::Score> forwardScores(scores);
-  std::vector<Types::Score> backwardScores(scores);
-  std::vector<std::pair<Types::Score, int>> firstScore;
-  firstScore.resize(n, std::pair<Types::Score, int>(-1, -1));
+  const std::vector<int> &parents = ws.parents;
+  const std::vector<Types::Score> &scores = ws.scores;
+  Types::Bitset &forwardPred = ws.forwardPred;
+  getPred(ordering, pivot, forwardPred);
+  Types::Bitset &backwardPred = ws.backwardPred;
+  backwardPred = forwardPred;
+  std::vector<int> &passedParents = ws.passedParents;
+  std::vector<Types::Score> &passedScores = ws.passedScores;
+  std::vector<std::pair<Types::Score, int>> &firstScore = ws.firstScore;
+  int pivotVarId = ordering.get(pivot);
   Types::Score curScore = initScore;
   Types::Score bestScore = initScore;
   int bestPivot = -1;
-  Ordering forwardModified(ordering);
-  Ordering backwardModified(ordering);
+  int pivotParent = parents[pivotVarId];
+  Types::Score pivotScore = scores[pivotVarId];
   //DBG("CURRENT ORDERING: " << ordering << " PIVOT: " << pivot);
   //DBG("FORWARD");
-  for (int i = pivot; i + 1 < n; i++) {
-    //DBG("ON PIVOT " << i);
-    //DBG("Current Pred: " << forwardPred);
-    for (int i = 0; i < n; i++) {
-      //DBG("Var idx: " << i << " Var: " << forwardModified.get(i) << " Parent: " << forwardParents[forwardModified.get(i)] << " Scores: " << forwardScores[forwardModified.get(i)]);
-    }
-    SwapResult sr = findBestScoreSwap(forwardModified, i, forwardParents, forwardPred);
-    Types::Score oldScore = forwardScores[forwardModified.get(i)] + forwardScores[forwardModified.get(i+1)];
-    //DBG("Var(i): " << forwardModified.get(i) <<" Var(i+1): " << forwardModified.get(i+1) << " StoredScore(i): " << forwardScores[forwardModified.get(i)] << " StoreScore(i+1) " << forwardScores[forwardModified.get(i+1)]);
+  int i = pivot;
+  for (; i + 1 < n && !deadline.expired(); i++) {
+    int passedVarId = ordering.get(i + 1);
+    SwapResult sr = findBestScoreSwap(ordering, i, pivotParent, parents[passedVarId], forwardPred);
+    Types::Score oldScore = pivotScore + scores[passedVarId];
     //DBG("Swap Result: " << sr);
-    forwardModified.swap(i, i+1);
-    forwardPred[forwardModified.get(i)] = 1;
+    ordering.swapUnhashed(i, i + 1);
+    forwardPred[passedVarId] = 1;
     std::pair<Types::Score, Types::Score> newParentScores = sr.getScores();
-    //DBG("new first " << newParentScores.first << " new second " << newParentScores.second);
-    forwardScores[forwardModified.get(i)] = newParentScores.first;
-    forwardScores[forwardModified.get(i + 1)] = newParentScores.second;
     std::pair<int, int> newParentSets = sr.getParentSets();
-    forwardParents[forwardModified.get(i)] = newParentSets.first;
-    forwardParents[forwardModified.get(i + 1)] = newParentSets.second;
-    firstScore[i + 1] = std::make_pair(newParentScores.second, newParentSets.second);
-    
-    Types::Score newScore = sr.getScore();
-    //DBG("OldScore: " << oldScore << " New Scores: " << newScore);
-    curScore += newScore - oldScore;
+    passedParents[passedVarId] = newParentSets.first;
+    passedScores[passedVarId] = newParentScores.first;
+    pivotParent = newParentSets.second;
+    pivotScore = newParentScores.second;
+    firstScore[i + 1] = std::make_pair(pivotScore, pivotParent);
+    curScore += sr.getScore() - oldScore;
     if (curScore < bestScore) {
       bestScore = curScore;
       bestPivot = i + 1;
     }
     //DBG("New Score: " << curScore);
   }
+  ordering.insertUnhashed(i, pivot);
   curScore = initScore;
+  pivotParent = parents[pivotVarId];
+  pivotScore = scores[pivotVarId];
   //DBG("BACKWARD");
-  for (int i = pivot - 1; i >= 0; i--) {
-    //DBG("ON PIVOT " << i);
-    //DBG("Current Pred: " << backwardPred);
-    for (int i = 0; i < n; i++) {
-      //DBG("Var idx: " << i << " Var: " << backwardModified.get(i) << " Parent: " << backwardParents[backwardModified.get(i)] << " Scores: " << backwardScores[backwardModified.get(i)]);
-    }
-    backwardPred[backwardModified.get(i)] = 0;
-    SwapResult sr = findBestScoreSwap(backwardModified, i, backwardParents, backwardPred);
-    Types::Score oldScore = backwardScores[backwardModified.get(i)] + backwardScores[backwardModified.get(i+1)];
-    backwardModified.swap(i, i+1);
-    /*
-    if (i - 1 >= 0) {
-      backwardPred[backwardModified.get(i - 1)] = 0;
-    }*/
+  for (i = pivot - 1; i >= 0 && !deadline.expired(); i--) {
+    int passedVarId = ordering.get(i);
+    backwardPred[passedVarId] = 0;
+    SwapResult sr = findBestScoreSwap(ordering, i, parents[passedVarId], pivotParent, backwardPred);
+    Types::Score oldScore = scores[passedVarId] + pivotScore;
+    ordering.swapUnhashed(i, i + 1);
     std::pair<Types::Score, Types::Score> newParentScores = sr.getScores();
-    backwardScores[backwardModified.get(i)] = newParentScores.first;
-    backwardScores[backwardModified.get(i + 1)] = newParentScores.second;
     std::pair<int, int> newParentSets = sr.getParentSets();
-    backwardParents[backwardModified.get(i)] = newParentSets.first;
-    backwardParents[backwardModified.get(i + 1)] = newParentSets.second;
-    firstScore[i] = std::make_pair(newParentScores.first, newParentSets.first);
-    Types::Score newScore = sr.getScore();
-    curScore += newScore - oldScore;
-    
+    passedParents[passedVarId] = newParentSets.second;
+    passedScores[passedVarId] = newParentScores.second;
+    pivotParent = newParentSets.first;
+    pivotScore = newParentScores.first;
+    firstScore[i] = std::make_pair(pivotScore, pivotParent);
+    curScore += sr.getScore() - oldScore;
     if (curScore < bestScore) {
       bestScore = curScore;
       bestPivot = i;
       //DBG("Found New Best " << bestScore);
     }
   }
+  ordering.insertUnhashed(i + 1, pivot);
+  return FastPivotResult(bestScore, bestPivot);
+}
 
-  
-  std::vector<int> newParents(parents);
-  std::vector<Types::Score> newScores(scores);
-  Ordering modified(ordering);
-  if (bestPivot != -1 ) {
-    modified.insert(pivot, bestPivot);
-    if (bestPivot < pivot) {
-      for (int k = pivot; k > bestPivot; k--) {
-        int varId = modified.get(k);
-        newParents[varId] = backwardParents[varId];
-        newScores[varId] = backwardScores[varId];
-      }
-      int pivotVarId = modified.get(bestPivot);
-      newParents[pivotVarId] = firstScore[bestPivot].second;
-      newScores[pivotVarId] = firstScore[bestPivot].first;
-    } else if (bestPivot > pivot) {
-      for (int k = pivot; k < bestPivot; k++) {
-        int varId = modified.get(k);
-        newParents[varId] = forwardParents[varId];
-        newScores[varId] = forwardScores[varId];
-      }
-      int pivotVarId = modified.get(bestPivot);
-      newParents[pivotVarId] = firstScore[bestPivot].second;
-      newScores[pivotVarId] = firstScore[bestPivot].first;
-    }
-    return FastPivotResult(bestScore, bestPivot, modified, newParents, newScores);
-  } else {
-    return FastPivotResult(bestScore, bestPivot, modified, newParents, newScores);
+// Replays the move of pivot to dest recorded by the last getBestInsertFast or
+// getInsertScore on ordering and pivot; only the variables it passes over change parents.
+void LocalSearch::applyBestInsert(Ordering &ordering, int pivot, int dest, ScoringWorkspace &ws) const {
+  std::vector<int> &parents = ws.parents;
+  std::vector<Types::Score> &scores = ws.scores;
+  int start = dest < pivot ? dest : pivot + 1;
+  int end = dest < pivot ? pivot : dest + 1;
+  for (int k = start; k < end; k++) {
+    int varId = ordering.get(k);
+    parents[varId] = ws.passedParents[varId];
+    scores[varId] = ws.passedScores[varId];
   }
+  int pivotVarId = ordering.get(pivot);
+  parents[pivotVarId] = ws.firstScore[dest].second;
+  scores[pivotVarId] = ws.firstScore[dest].first;
+  ordering.insert(pivot, dest);
 }
 
 
 
 PivotResult LocalSearch::getBestInsert(const Ordering &ordering, int pivot, Types::Score initScore) const {
-  Types::Bitset forwardPred = getPred(ordering, pivot);
+  Types::Bitset forwardPred(instance.getN());
+  getPred(ordering, pivot, forwardPred);
   Types::Bitset backwardPred(forwardPred);
   Types::Score curScore = initScore;
   Types::Score bestScore = Types::SCORE_MAX;
@@ -632,84 +738,103 @@ PivotResult LocalSearch::getBestInsert(const Ordering &ordering, int pivot, Type
   return ret;
 }
 
-SearchResult LocalSearch::hillClimb(const Ordering &ordering) {
-  bool improving = false;
+// First improvement with don't-look bits. Every variable starts queued, in
+// random order, and a pivot that fails to improve is dropped from the queue.
+// After a move the variables it passed over and the two next to it are queued
+// again, behind the pivots not yet tried. That is only a guess: a move changes
+// the predecessors of every variable it passes, which can open an improving
+// insert for a pivot anywhere. So when the queue runs dry after an improving
+// move, every variable is queued again for a full pass, those that improved
+// most recently first, and the climb ends after a pass without improvement,
+// at an ordering no single insert improves.
+SearchResult LocalSearch::hillClimb(const Ordering &ordering, ScoringWorkspace &ws, Rng &rng, Deadline &deadline) {
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
   int steps = 0;
-  std::vector<int> positions(n);
+  int evaluations = 0;
+  std::vector<int> &positions = ws.positions;
+  PivotQueue &pivots = ws.pivots;
+  std::vector<int> &improved = ws.improved;
+  std::vector<int> &lastImproved = ws.lastImproved;
   Ordering cur(ordering);
-  Types::Score curScore = getBestScoreWithParents(cur, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(cur, ws.parents, ws.scores, ws);
   std::iota(positions.begin(), positions.end(), 0);
+  rng.shuffle(positions.begin(), positions.end());
+  pivots.clear();
+  for (int s = 0; s < n; s++) {
+    pivots.push(cur.get(positions[s]));
+  }
+  improved.clear();
+  std::fill(lastImproved.begin(), lastImproved.end(), 0);
+  int passStart = 0;
   DBG("Inits: " << cur);
-  do {
-    improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
-    for (int s = 0; s < n && !improving; s++) {
-      int pivot = positions[s];
-      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, parents, scores);
-      if (result.getScore() < curScore) {
-        steps += 1;
-        improving = true;
-        cur.insert(pivot, result.getSwapIdx());
-        parents = result.getParents();
-        scores = result.getScores();
-        curScore = result.getScore();
+#ifdef DEBUG
+  uint64_t allocations = AllocationCounter::get();
+#endif
+  while (!deadline.expired()) {
+    if (pivots.empty()) {
+      if (improved.empty()) {
+        break;
       }
+      std::sort(improved.begin(), improved.end(), [&lastImproved](int a, int b) {
+        return lastImproved[a] > lastImproved[b];
+      });
+      for (int var : improved) {
+        pivots.push(var);
+      }
+      improved.clear();
+      rng.shuffle(positions.begin(), positions.end());
+      for (int s = 0; s < n; s++) {
+        pivots.push(positions[s]);
+      }
+      passStart = steps;
     }
-    DBG("Cur Score: " << curScore);
-  } while(improving);
-  DBG("Total Steps: " << steps);
-  return SearchResult(curScore, cur);
-}
-
-SearchResult LocalSearch::hillClimb(const Ordering &ordering, float timeLimit, ResultRegister &rr) {
-  bool improving = false;
-  int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
-  int steps = 0;
-  std::vector<int> positions(n);
-  Ordering cur(ordering);
-  Types::Score curScore = getBestScoreWithParents(cur, parents, scores);
-  std::iota(positions.begin(), positions.end(), 0);
-  DBG("Inits: " << cur << " Time: " << rr.check());
-  do {
-    improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
-    for (int s = 0; s < n && !improving; s++) {
-      int pivot = positions[s];
-      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, parents, scores);
-      if (result.getScore() < curScore) {
-        steps += 1;
-        improving = true;
-        cur.insert(pivot, result.getSwapIdx());
-        parents = result.getParents();
-        scores = result.getScores();
-        curScore = result.getScore();
+    int var = pivots.pop();
+    int pivot = cur.getPosition(var);
+    FastPivotResult result = getBestInsertFast(cur, pivot, curScore, ws, deadline);
+    evaluations++;
+    if (result.getScore() < curScore) {
+      int dest = result.getSwapIdx();
+      steps += 1;
+      if (lastImproved[var] <= passStart) {
+        improved.push_back(var);
+      }
+      lastImproved[var] = steps;
+      applyBestInsert(cur, pivot, dest, ws);
+      curScore = result.getScore();
+      int low = std::max(0, std::min(pivot, dest) - 1);
+      int high = std::min(n - 1, std::max(pivot, dest) + 1);
+      for (int k = low; k <= high; k++) {
+        pivots.push(cur.get(k));
       }
     }
-    DBG("Cur Score: " << curScore);
-    rr.record(curScore, cur);
-  } while(improving && (rr.check() <= timeLimit));
-  DBG("Total Steps: " << steps);
+  }
+  DBG("Total Steps: " << steps << " Evaluations: " << evaluations << " Allocations: " << AllocationCounter::get() - allocations);
   return SearchResult(curScore, cur);
 }
 
+SearchResult LocalSearch::hillClimb(const Ordering &ordering, float timeLimit, ResultRegister &rr, ScoringWorkspace &ws, Rng &rng) {
+  Deadline deadline = rr.deadline(timeLimit);
+  DBG("Inits: " << ordering << " Time: " << rr.check());
+  SearchResult climbed = hillClimb(ordering, ws, rng, deadline);
+  rr.record(climbed.getScore(), climbed.getOrdering());
+  return climbed;
+}
+
 SearchResult LocalSearch::tabuSearch(const Ordering &ordering, float timeLimit, int listSize, int softThreshold, ResultRegister &rr)  {
+  Deadline deadline = rr.deadline(timeLimit);
   int stepsSinceImprovement = 0;
   int n = instance.getN();
   int steps = 0;
   std::vector<int> positions(n);
   MoveTabuList tabuList(listSize, n);
-  Types::Score curScore = getBestScore(ordering);
+  ScoringWorkspace ws(n);
+  Types::Score curScore = getBestScore(ordering, ws);
   Ordering cur(ordering);
   std::iota(positions.begin(), positions.end(), 0);
   Types::Score bestSeenScore = Types::SCORE_MAX;
   DBG("Inits: " << cur << " Time: " << rr.check());
   do {
-    std::random_shuffle(positions.begin(), positions.end());
+    rng.shuffle(positions.begin(), positions.end());
     Types::Score bestScore = Types::SCORE_MAX;
     int bestPivot = -1;
     int bestLocation = -1;
@@ -737,7 +862,7 @@ SearchResult LocalSearch::tabuSearch(const Ordering &ordering, float timeLimit,
       break;
     }
     DBG("Cur Score: " << curScore);
-  } while(stepsSinceImprovement < softThreshold && rr.check() <= timeLimit);
+  } while(stepsSinceImprovement < softThreshold && !deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
@@ -747,12 +872,12 @@ SearchResult LocalSearch::tabuSearch(const Ordering &ordering, float timeLimit,
    Types::Score bestScore = Types::SCORE_MAX;
    SearchResult best(bestScore, Ordering(n));
    do {
-     Ordering o = Ordering::greedyOrdering(instance);
+     Ordering o = Ordering::greedyOrdering(instance, rng);
      SearchResult cur = tabuSearch(o, timeLimit, listSize, softThreshold, rr);
      if (cur.getScore() < best.getScore()) {
        best = cur;
      }
-   } while (!Util::isOpt(best, opt) && rr.check() < timeLimit);
+   } while (!Util::isOpt(best, opt) && !rr.deadline(timeLimit).reached());
    return best; 
  }
 
@@ -760,10 +885,12 @@ SearchResult LocalSearch::hillClimbingWithNRestarts(int numRestarts, ResultRegis
   int n = instance.getN();
   Types::Score bestScore = Types::SCORE_MAX;
   SearchResult best(bestScore, Ordering(n));
+  ScoringWorkspace ws(n);
+  Deadline never;
   rr.set();
   for (int i = 0; i < numRestarts; i++) {
-    Ordering o = Ordering::greedyOrdering(instance);
-    SearchResult cur = hillClimb(o);
+    Ordering o = Ordering::greedyOrdering(instance, 10, rng);
+    SearchResult cur = hillClimb(o, ws, rng, never);
     if (cur.getScore() < best.getScore()) {
       rr.record(cur.getScore(), cur.getOrdering());
       best = cur;
@@ -778,24 +905,25 @@ SearchResult LocalSearch::ILSWithNRestarts(float timeLimit, int greediness, int
   SearchResult best(bestScore, Ordering(n));
 
   do {
-    Ordering o = Ordering::randomOrdering(instance);
+    Ordering o = Ordering::randomOrdering(instance, rng);
     SearchResult cur = ILS(o, MAX_PERTURBS, IMPROVE_THRESHHOLD, PERTURB_FACTOR, updateTolerance, rr, timeLimit, opt);
     if (cur.getScore() < best.getScore()) {
       best = cur;
     }
-  } while (!Util::isOpt(best, opt) && rr.check() < timeLimit);
+  } while (!Util::isOpt(best, opt) && !rr.deadline(timeLimit).reached());
   return best;
 }
 
 SearchResult LocalSearch::ILS(const Ordering &ordering, int MAX_PERTURBS, int IMPROVE_THRESHHOLD, int PERTURB_FACTOR, float updateTolerance, ResultRegister &rr, float timeLimit, Types::Score opt) {
   DBG("ILS(" << MAX_PERTURBS << ", " << IMPROVE_THRESHHOLD << ")");
-  SearchResult s = hillClimb(ordering, timeLimit, rr);
+  ScoringWorkspace ws(instance.getN());
+  SearchResult s = hillClimb(ordering, timeLimit, rr, ws, rng);
   int numPerturbs = 0;
   int timeSinceLastImprovement = 0;
   while (numPerturbs < MAX_PERTURBS && timeSinceLastImprovement < IMPROVE_THRESHHOLD) {
     Ordering perturbed(s.getOrdering());
-    perturbed.perturb(PERTURB_FACTOR);
-    SearchResult climbed = hillClimb(perturbed, timeLimit, rr);
+    perturbed.perturb(PERTURB_FACTOR, rng);
+    SearchResult climbed = hillClimb(perturbed, timeLimit, rr, ws, rng);
     if ((1.0-updateTolerance)*(float)climbed.getScore() < s.getScore()) {
       DBG("Tolerance: "<< (1.0-updateTolerance)*(double)climbed.getScore() );
       timeSinceLastImprovement = 0;
@@ -807,7 +935,7 @@ SearchResult LocalSearch::ILS(const Ordering &ordering, int MAX_PERTURBS, int IM
     if (climbed.getScore() < rr.getBest()) {
       rr.record(climbed.getScore(), climbed.getOrdering());
     }
-    if (rr.check() > timeLimit || Util::isOpt(s, opt)) {
+    if (rr.deadline(timeLimit).reached() || Util::isOpt(s, opt)) {
       return s;
     }
   }
@@ -826,10 +954,10 @@ std::vector<int> LocalSearch::bestParentIds(const Ordering &ordering) {
   return parents;
 }
 
-SearchResult LocalSearch::makeResult(const Ordering &ordering) const {
+SearchResult LocalSearch::makeResult(const Ordering &ordering, ScoringWorkspace &ws) const {
   int n = instance.getN();
-  Types::Bitset pred(n, 0);
-  std::vector<int> parents(0);
+  Types::Bitset &pred = ws.pred;
+  pred.reset();
   Types::Score score = 0;
   for (int i = 0; i < n; i++) {
     score += bestParent(ordering, pred, i).getScore();
@@ -838,91 +966,90 @@ SearchResult LocalSearch::makeResult(const Ordering &ordering) const {
   return SearchResult(score, ordering);
 }
 
+// Variables by depth in the network of their best parent sets, ties by
+// variable. Parents precede their children in ordering, so one pass in order
+// sets every depth, and a counting sort over the depths (below n) does.
 Ordering LocalSearch::depthSort(const Ordering &ordering) {
   std::vector<int> parentIds = bestParentIds(ordering);
   int n = instance.getN();
   std::vector<int> depth(n);
+  std::vector<int> start(n + 1, 0);
   for (int i = 0; i < n; i++) {
-    const Variable &v = instance.getVar(ordering.get(i));
-    ParentSet p = v.getParent(parentIds[i]);
-    int d = getDepth(i, depth, ordering, p);
-    depth[i] = d;
+    int var = ordering.get(i);
+    int d = 0;
+    for (int parent : instance.getVar(var).getParent(parentIds[i]).getParentsVec()) {
+      d = std::max(d, depth[parent] + 1);
+    }
+    depth[var] = d;
+    start[d + 1]++;
     DBG("Depth: " << d);
-
   }
-  std::vector<std::pair<int, int>> depth_var;
-  for (int i = 0; i < n; i++) {
-    depth_var.push_back(std::make_pair(depth[i], ordering.get(i)));
+  for (int d = 1; d < n; d++) {
+    start[d] += start[d - 1];
   }
-  std::sort(depth_var.begin(), depth_var.end());
   Ordering ret(n);
-  for (int i = 0; i < n; i++) {
-    ret.set(i, depth_var[i].second);
+  for (int var = 0; var < n; var++) {
+    ret.set(start[depth[var]]++, var);
   }
   return ret;
 }
 
-int LocalSearch::getDepth(int m, const std::vector<int> &depth, const Ordering &ordering, const ParentSet &parent) {
-  int n = instance.getN();
-  std::vector<int> inDepth(n, n-1);
-
-  for (int i = 0; i < m; i++) {
-    inDepth[ordering.get(i)] = depth[i];
-  }
-  int d = 0;
-  for (int i = 0; i < n; i++) {
-    if (parent.hasElement(i)) {
-      if (d < inDepth[i] + 1) {
-        d = inDepth[i] + 1;
-      }
+// One generation: crossovers and mutations are climbed and merged into the
+// population, which is diversified once its average fitness stops moving.
+void LocalSearch::evolve(Population &population, std::deque<Types::Score> &fitnesses, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS,
+    int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType) {
+  //DBG(population);
+  std::vector<SearchResult> offspring;
+  population.addCrossovers(NUM_CROSSOVERS, crossoverType, offspring);
+  //DBG(population);
+  population.mutate(NUM_MUTATIONS, MUTATION_POWER, offspring);
+  //DBG(population);
+  population.append(offspring);
+  population.filterBest(INIT_POPULATION_SIZE);
+  DBG(population);
+  Types::Score fitness = population.getAverageFitness();
+  fitnesses.push_back(fitness);
+  if (fitnesses.size() > DIV_LOOKAHEAD) {
+    Types::Score oldFitness = fitnesses.front();
+    fitnesses.pop_front();
+    float change = std::abs(((float)fitness-(float)oldFitness)/(float)oldFitness);
+    if (change < DIV_TOLERANCE && DIV_TOLERANCE != -1) {
+      DBG("Diversification Step. Change: " << change << " Old: " << oldFitness << " New: " << fitness);
+      population.diversify(NUM_KEEP, instance);
+      fitnesses.clear();
     }
   }
-  return d;
+  DBG("Fitness: " << population.getAverageFitness());
+}
+
+void LocalSearch::reportClimbCache(long hits, long lookups) {
+  if (lookups > 0) {
+    std::cout << "Climb cache: " << hits << " hits in " << lookups << " lookups (" << 100.0 * hits / lookups << "%)" << std::endl;
+  }
 }
 
 SearchResult LocalSearch::genetic(float cutoffTime, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS,
-    int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, Types::Score opt, ResultRegister &rr) {
+    int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, Types::Score opt, ResultRegister &rr, int numThreads,
+    int climbCacheSize) {
   int n = instance.getN();
   SearchResult best(Types::SCORE_MAX, Ordering(n));
   std::deque<Types::Score> fitnesses;
-  Population population(*this);
+  WorkerPool pool(numThreads);
+  Population population(*this, pool, rng.next(), climbCacheSize);
+  Deadline deadline = rr.deadline(cutoffTime);
+  population.setDeadline(deadline);
   int numGenerations = 1;
-  std::cout << "Time: " << rr.check() << " Generating initial population" << std::endl;
-  for (int i = 0; i < INIT_POPULATION_SIZE; i++) {
-    SearchResult o;
-    if (greediness == -1) {
-      o = hillClimb(Ordering::randomOrdering(instance));
-    } else {
-      o = hillClimb(Ordering::greedyOrdering(instance, greediness));
-    }
+  std::cout << "Time: " << rr.check() << " Generating initial population on " << pool.getNumThreads() << " threads" << std::endl;
+  std::vector<SearchResult> initial;
+  population.generate(INIT_POPULATION_SIZE, greediness, initial);
+  for (const SearchResult &o : initial) {
     rr.record(o.getScore(), o.getOrdering());
     population.addSpecimen(o);
   }
   std::cout << "Done generating initial population" << std::endl;
   do {
     std::cout << "Time: " << rr.check() << " Starting generation " << numGenerations << std::endl;
-    //DBG(population);
-    std::vector<SearchResult> offspring;
-    population.addCrossovers(NUM_CROSSOVERS, crossoverType, offspring);
-    //DBG(population);
-    population.mutate(NUM_MUTATIONS, MUTATION_POWER, offspring);
-    //DBG(population);
-    population.append(offspring);
-    population.filterBest(INIT_POPULATION_SIZE);
-    DBG(population);
-    Types::Score fitness = population.getAverageFitness();
-    fitnesses.push_back(fitness);
-    if (fitnesses.size() > DIV_LOOKAHEAD) {
-      Types::Score oldFitness = fitnesses.front();
-      fitnesses.pop_front();
-      float change = std::abs(((float)fitness-(float)oldFitness)/(float)oldFitness);
-      if (change < DIV_TOLERANCE && DIV_TOLERANCE != -1) {
-        DBG("Diversification Step. Change: " << change << " Old: " << oldFitness << " New: " << fitness);
-        population.diversify(NUM_KEEP, instance);
-        fitnesses.clear();
-      }
-    }
-    DBG("Fitness: " << population.getAverageFitness());
+    evolve(population, fitnesses, INIT_POPULATION_SIZE, NUM_CROSSOVERS, NUM_MUTATIONS, MUTATION_POWER, DIV_LOOKAHEAD, NUM_KEEP, DIV_TOLERANCE, crossoverType);
     SearchResult curBest = population.getSpecimen(0);
     Types::Score curScore = curBest.getScore();
     std::cout << "Time: " << rr.check() <<  " The best score at this iteration is: " << curScore << std::endl;
@@ -931,32 +1058,134 @@ SearchResult LocalSearch::genetic(float cutoffTime, int INIT_POPULATION_SIZE, in
       best = curBest;
     }
     numGenerations++;
-  } while (rr.check() < cutoffTime);
+  } while (!deadline.reached());
   std::cout << "Generations: " << numGenerations << std::endl;
+  reportClimbCache(population.getCache().getHits(), population.getCache().getLookups());
+  return best;
+}
+
+// Island model: every island evolves its own population on its own thread
+// (crossover types rotate over the islands and the mutation power grows every
+// three islands). Every MIGRATION_INTERVAL generations an island sends its
+// NUM_MIGRANTS best specimens to the next island, or to a random one, and
+// takes in whatever reached its own mailbox.
+SearchResult LocalSearch::islands(float cutoffTime, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS,
+    int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, ResultRegister &rr,
+    int numThreads, int numIslands, int MIGRATION_INTERVAL, int NUM_MIGRANTS, bool randomTopology, int climbCacheSize) {
+  int n = instance.getN();
+  const CrossoverType crossoverTypes[] = { CrossoverType::OB, CrossoverType::CX, CrossoverType::RK };
+  int firstType = 0;
+  while (crossoverTypes[firstType] != crossoverType) {
+    firstType++;
+  }
+  std::vector<std::unique_ptr<Mailbox>> mailboxes;
+  std::vector<uint64_t> seeds;
+  for (int i = 0; i < numIslands; i++) {
+    mailboxes.push_back(std::unique_ptr<Mailbox>(new Mailbox(4 * NUM_MIGRANTS)));
+    seeds.push_back(rng.next());
+  }
+  std::vector<SearchResult> bests(numIslands, SearchResult(Types::SCORE_MAX, Ordering(n)));
+  std::vector<int> generations(numIslands, 0);
+  std::vector<long> cacheHits(numIslands, 0);
+  std::vector<long> cacheLookups(numIslands, 0);
+  std::mutex consoleMutex;
+  std::cout << "Time: " << rr.check() << " Starting " << numIslands << " islands" << std::endl;
+  auto island = [&](int i) {
+    WorkerPool pool(std::max(1, numThreads / numIslands));
+    Population population(*this, pool, seeds[i], climbCacheSize);
+    Deadline deadline = rr.deadline(cutoffTime);
+    population.setDeadline(deadline);
+    Rng topologyRng(seeds[i], numIslands);
+    CrossoverType type = crossoverTypes[(firstType + i) % 3];
+    int mutationPower = MUTATION_POWER * (1 + i / 3);
+    std::deque<Types::Score> fitnesses;
+    auto report = [&]() {
+      const SearchResult &curBest = population.getSpecimen(0);
+      if (curBest.getScore() < bests[i].getScore()) {
+        bests[i] = curBest;
+        if (rr.record(curBest.getScore(), curBest.getOrdering())) {
+          std::lock_guard<std::mutex> lock(consoleMutex);
+          std::cout << "Time: " << rr.check() << " Island " << i << " generation " << generations[i] << " found: " << curBest.getScore() << std::endl;
+        }
+      }
+    };
+    std::vector<SearchResult> initial;
+    population.generate(INIT_POPULATION_SIZE, greediness, initial);
+    for (const SearchResult &o : initial) {
+      population.addSpecimen(o);
+    }
+    population.filterBest(INIT_POPULATION_SIZE);
+    report();
+    while (!deadline.reached()) {
+      evolve(population, fitnesses, INIT_POPULATION_SIZE, NUM_CROSSOVERS, NUM_MUTATIONS, mutationPower, DIV_LOOKAHEAD, NUM_KEEP, DIV_TOLERANCE, type);
+      generations[i]++;
+      if (numIslands > 1 && generations[i] % MIGRATION_INTERVAL == 0) {
+        int target = (i + 1) % numIslands;
+        if (randomTopology) {
+          target = topologyRng.uniform(numIslands - 1);
+          target += target >= i;
+        }
+        for (int m = 0; m < NUM_MIGRANTS && m < population.getSize(); m++) {
+          mailboxes[target]->send(population.getSpecimen(m));
+        }
+        SearchResult migrant;
+        bool received = false;
+        while (mailboxes[i]->receive(migrant)) {
+          population.addSpecimen(migrant);
+          received = true;
+        }
+        if (received) {
+          population.filterBest(INIT_POPULATION_SIZE);
+        }
+      }
+      report();
+    }
+    cacheHits[i] = population.getCache().getHits();
+    cacheLookups[i] = population.getCache().getLookups();
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numIslands; i++) {
+    threads.push_back(std::thread(island, i));
+  }
+  island(0);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  SearchResult best = bests[0];
+  int numGenerations = 0;
+  long hits = 0;
+  long lookups = 0;
+  for (int i = 0; i < numIslands; i++) {
+    if (bests[i].getScore() < best.getScore()) {
+      best = bests[i];
+    }
+    numGenerations += generations[i];
+    hits += cacheHits[i];
+    lookups += cacheLookups[i];
+  }
+  std::cout << "Generations: " << numGenerations << std::endl;
+  reportClimbCache(hits, lookups);
   return best;
 }
 
 SearchResult LocalSearch::hillClimbBestImprove(Ordering ordering, float cutoffTime, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(cutoffTime);
   
   int n = instance.getN();
   int steps = 0;
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
+  ScoringWorkspace ws(n);
+  Deadline never;
   Ordering cur(ordering);
-  Types::Score curScore = getBestScoreWithParents(cur, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(cur, ws.parents, ws.scores, ws);
   DBG("Inits: " << cur << " Time: " << rr.check());
   do {
     Types::Score bestScore = Types::SCORE_MAX;
     int bestPivot = -1;
     int bestLocation = -1;
-    std::vector<int> bestParents;
-    std::vector<Types::Score> bestScores;
     for (int s = 0; s < n; s++) {
       int pivot = s;
-      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, parents, scores);
+      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, ws, deadline);
       if (result.getScore() < bestScore) {
-        bestParents = result.getParents();
-        bestScores = result.getScores();
         bestPivot = s;
         bestLocation = result.getSwapIdx();
         bestScore = result.getScore();
@@ -964,31 +1193,33 @@ SearchResult LocalSearch::hillClimbBestImprove(Ordering ordering, float cutoffTi
     }
     if (bestScore < curScore) {
       steps++;
-      cur.insert(bestPivot, bestLocation);
+      // Other pivots have been scanned since; redo the best one to replay it.
+      getBestInsertFast(cur, bestPivot, curScore, ws, never);
+      applyBestInsert(cur, bestPivot, bestLocation, ws);
       curScore = bestScore;
-      parents = bestParents;
-      scores = bestScores;
     } else {
       break;
     }
     DBG("Cur Score: " << curScore);
-  } while(rr.check() <= cutoffTime);
+  } while(!deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
 
 SearchResult LocalSearch::hillClimbOldHybridImprove(Ordering ordering, float cutoffTime, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(cutoffTime);
   bool improving = false;
   int n = instance.getN();
   int steps = 0;
   std::vector<int> positions(n);
-  Types::Score curScore = getBestScore(ordering);
+  ScoringWorkspace ws(n);
+  Types::Score curScore = getBestScore(ordering, ws);
   Ordering cur(ordering);
   std::iota(positions.begin(), positions.end(), 0);
   DBG("Inits: " << cur << " Time: " << rr.check());
   do {
     improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
+    rng.shuffle(positions.begin(), positions.end());
     for (int s = 0; s < n && !improving; s++) {
       int pivot = positions[s];
       //DBG("checking pivot " << pivot);
@@ -1003,20 +1234,20 @@ SearchResult LocalSearch::hillClimbOldHybridImprove(Ordering ordering, float cut
     }
     DBG("Cur Score: " << curScore);
     rr.record(curScore, cur);
-  } while(improving && (rr.check() <= cutoffTime));
+  } while(improving && !deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
 
 SearchResult LocalSearch::hillClimbHybridImprove(Ordering ordering, float cutoffTime, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(cutoffTime);
   bool improving = false;
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
+  ScoringWorkspace ws(n);
   Ordering cur(ordering);
-  Types::Score curScore = getBestScoreWithParents(cur, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(cur, ws.parents, ws.scores, ws);
   int steps = 0;
-  std::vector<int> positions(n);
+  std::vector<int> &positions = ws.positions;
   std::iota(positions.begin(), positions.end(), 0);
   DBG("Inits: " << cur << " Time: " << rr.check());
   do {
@@ -1024,67 +1255,64 @@ SearchResult LocalSearch::hillClimbHybridImprove(Ordering ordering, float cutoff
     //  DBG("INdex: " << i << " Variable: " << cur.get(i) << " Parent Set: " << parents[cur.get(i)] << " Score: " << scores[cur.get(i)]);
     //}
     improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
+    rng.shuffle(positions.begin(), positions.end());
     for (int s = 0; s < n && !improving; s++) {
       int pivot = positions[s];
       //DBG("checking pivot " << pivot);
-      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, parents, scores);
+      FastPivotResult result = getBestInsertFast(cur, pivot, curScore, ws, deadline);
       if (result.getScore() < curScore) {
         steps += 1;
         improving = true;
         //DBG("Inserting " << pivot << " to " << result.getSwapIdx());
-        cur.insert(pivot, result.getSwapIdx());
-        parents = result.getParents();
-        scores = result.getScores();
+        applyBestInsert(cur, pivot, result.getSwapIdx(), ws);
         curScore = result.getScore();
 
       }
     }
     DBG("Cur Score: " << curScore);
-  } while(improving && (rr.check() <= cutoffTime));
+  } while(improving && !deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
 
 SearchResult LocalSearch::hillClimbFirstImproveV1(Ordering ordering, float cutoffTime, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(cutoffTime);
   bool improving = false;
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
+  ScoringWorkspace ws(n);
   
   int steps = 0;
   std::vector<int> positions(n*n);
   Ordering cur(ordering);
-  Types::Score curScore = getBestScoreWithParents(cur, parents, scores);
+  Types::Score curScore = getBestScoreWithParents(cur, ws.parents, ws.scores, ws);
 
   std::iota(positions.begin(), positions.end(), 0);
   DBG("Inits: " << cur << " Time: " << rr.check());
   do {
     improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
+    rng.shuffle(positions.begin(), positions.end());
     for (int i = 0; i < n*n && !improving; i++) {
       int s = positions[i]/n;
       int t = positions[i]%n;
       if (s==t) continue;
-      FastPivotResult newResult = getInsertScore(cur, s, t, curScore, parents, scores);
+      FastPivotResult newResult = getInsertScore(cur, s, t, curScore, ws, -1);
       if (newResult.getScore() < curScore) {
         curScore = newResult.getScore();
-        cur = newResult.getOrdering();
-        scores = newResult.getScores();
-        parents = newResult.getParents();
+        applyBestInsert(cur, s, newResult.getSwapIdx(), ws);
         steps += 1;
         improving = true;
       }
     }
     DBG("Cur Score: " << curScore);
-  } while(improving && (rr.check() <= cutoffTime));
+  } while(improving && !deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
 
 
 PivotResult LocalSearch::getBestInsertWithHook(const Ordering &ordering, int pivot, Types::Score initScore, std::vector<std::vector<Types::Score>> &hook) const {
-  Types::Bitset forwardPred = getPred(ordering, pivot);
+  Types::Bitset forwardPred(instance.getN());
+  getPred(ordering, pivot, forwardPred);
   Types::Bitset backwardPred(forwardPred);
   Types::Score curScore = initScore;
   Types::Score bestScore = Types::SCORE_MAX;
@@ -1151,12 +1379,14 @@ PivotResult LocalSearch::getBestInsertWithHook(const Ordering &ordering, int piv
 }
 
 SearchResult LocalSearch::hillClimbFirstImproveV2(Ordering ordering, float cutoffTime, ResultRegister &rr) {
+  Deadline deadline = rr.deadline(cutoffTime);
   bool improving = false;
   int n = instance.getN();
   int steps = 0;
   std::vector<std::vector<Types::Score>> hook;
   hook.resize(n, std::vector<Types::Score>(n, -1));
-  Types::Score curScore = getBestScore(ordering);
+  ScoringWorkspace ws(n);
+  Types::Score curScore = getBestScore(ordering, ws);
 
   std::vector<int> positions(n*n);
   Ordering cur(ordering);
@@ -1167,7 +1397,7 @@ SearchResult LocalSearch::hillClimbFirstImproveV2(Ordering ordering, float cutof
       getBestInsertWithHook(cur, i, curScore, hook);
     }
     improving = false;
-    std::random_shuffle(positions.begin(), positions.end());
+    rng.shuffle(positions.begin(), positions.end());
     for (int i = 0; i < n*n && !improving; i++) {
       int s = positions[i]/n;
       int t = positions[i]%n;
@@ -1182,7 +1412,7 @@ SearchResult LocalSearch::hillClimbFirstImproveV2(Ordering ordering, float cutof
     }
     DBG("Cur Score: " << curScore);
     rr.record(curScore, cur);
-  } while(improving && (rr.check() <= cutoffTime));
+  } while(improving && !deadline.expired());
   DBG("Total Steps: " << steps);
   return SearchResult(curScore, cur);
 }
@@ -1196,9 +1426,9 @@ SearchResult LocalSearch::hillClimbWithRestartsProbe(SelectType type, int numRun
      rr.set();
      Ordering o(n);
      if (greediness == -1) {
-       o = Ordering::randomOrdering(instance);
+       o = Ordering::randomOrdering(instance, rng);
      } else {
-       o = Ordering::greedyOrdering(instance, greediness);
+       o = Ordering::greedyOrdering(instance, greediness, rng);
      }
      SearchResult cur(bestScore, o);
      if (type == SelectType::FIRSTV1) {
@@ -1223,9 +1453,10 @@ SearchResult LocalSearch::hillClimbWithRestartsProbe(SelectType type, int numRun
 
 void LocalSearch::checkSolution(const Ordering &o) {
   int n = instance.getN();
-  std::vector<int> parents(n);
-  std::vector<Types::Score> scores(n);
-  getBestScoreWithParents(o, parents, scores);
+  ScoringWorkspace ws(n);
+  std::vector<int> &parents = ws.parents;
+  std::vector<Types::Score> &scores = ws.scores;
+  getBestScoreWithParents(o, parents, scores, ws);
   long long scoreFromScores = 0;
   long long scoreFromParents = 0;
   std::vector<int> inverse(n);
@@ -1236,8 +1467,8 @@ void LocalSearch::checkSolution(const Ordering &o) {
   for (int i = 0; i < n; i++) {
     int var = o.get(i);
     const Variable &v = instance.getVar(var);
-    const ParentSet &p = v.getParent(parents[var]);
-    const std::vector<int> &parentVars = p.getParentsVec();
+    const ParentSet p = v.getParent(parents[var]);
+    ParentList parentVars = p.getParentsVec();
     std::string parentsStr = "";
     bool before = true;
     for (int j = 0; j < parentVars.size(); j++) {
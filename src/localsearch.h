@@ -1,7 +1,6 @@
 #ifndef LOCALSEARCH_H
 #define LOCALSEARCH_H 
 
-#include <boost/dynamic_bitset.hpp>
 #include "instance.h"
 #include "ordering.h"
 #include "pivotresult.h"
@@ -10,8 +9,15 @@
 #include "resultregister.h"
 #include "swapresult.h"
 #include "fastpivotresult.h"
+#include "scoringworkspace.h"
+#include "deadline.h"
+#include "climbcache.h"
+#include "rng.h"
+#include <deque>
 #include "types.h"
 
+class Population;
+
 enum class Neighbours {
   SWAP,
   INSERT
@@ -33,32 +39,48 @@ enum class SelectType {
 
 class LocalSearch {
   public:
-    LocalSearch(const Instance &instance);
-    const ParentSet &bestParent(const Ordering &ordering, const Types::Bitset pred, int idx) const;
-    const ParentSet &bestParentVar(const Types::Bitset pred, const Variable &v) const;
-    const ParentSet *bestParentVarWithParent(const Types::Bitset pred, const Variable &a, const Variable &b, const Types::Score orig) const;
-    Types::Bitset getPred(const Ordering &ordering, int idx) const;
-    Types::Score getBestScore(const Ordering &ordering) const;
-    Types::Score getBestScoreWithParents(const Ordering &ordering, std::vector<int> &parents, std::vector<Types::Score> &scores) const;
+    // seed starts the random stream of the searches; parallel searches split
+    // their streams off it.
+    LocalSearch(const Instance &instance, uint64_t seed = 0);
+    const Instance &getInstance() const { return instance; }
+    ParentSet bestParent(const Ordering &ordering, const Types::Bitset &pred, int idx) const;
+    ParentSet bestParentVar(const Types::Bitset &pred, const Variable &v) const;
+    int bestParentVarWithParent(const Types::Bitset &pred, const Variable &a, const Variable &b, const Types::Score orig) const;
+    ParentSet bestParentVarAt(const Ordering &ordering, int idx, const Variable &v) const;
+    int bestParentVarWithParentAt(const Ordering &ordering, int idx, const Variable &a, const Variable &b, const Types::Score orig) const;
+    // Fills pred with the variables before position idx.
+    void getPred(const Ordering &ordering, int idx, Types::Bitset &pred) const;
+    Types::Score getBestScore(const Ordering &ordering, ScoringWorkspace &ws) const;
+    Types::Score getBestScoreWithParents(const Ordering &ordering, std::vector<int> &parents, std::vector<Types::Score> &scores, ScoringWorkspace &ws) const;
     SwapResult findBestScoreSwap(const Ordering &ordering, int i, const std::vector<int> &parents, Types::Bitset &pred);
+    // aParent and bParent are the current parent sets of the variables at i and i + 1.
+    SwapResult findBestScoreSwap(const Ordering &ordering, int i, int aParent, int bParent, Types::Bitset &pred);
     PivotResult getBestInsert(const Ordering &ordering, int pivot, Types::Score initScore) const;
-    FastPivotResult getBestInsertFast(const Ordering &ordering, int pivot, Types::Score initScore, const std::vector<int> &parents, const std::vector<Types::Score> &scores);
-    SearchResult makeResult(const Ordering &ordering) const;
-    SearchResult hillClimb(const Ordering &ordering);
-    SearchResult hillClimb(const Ordering &ordering, float timeLimit, ResultRegister &rr);
+    // Best insertion of pivot given ws.parents/ws.scores for ordering, which
+    // is left unchanged. Once deadline expires the scan stops and the best
+    // insertion seen so far is returned.
+    FastPivotResult getBestInsertFast(Ordering &ordering, int pivot, Types::Score initScore, ScoringWorkspace &ws, Deadline &deadline);
+    // Moves pivot to dest, as evaluated by the last getBestInsertFast, and
+    // updates ws.parents/ws.scores in place.
+    void applyBestInsert(Ordering &ordering, int pivot, int dest, ScoringWorkspace &ws) const;
+    SearchResult makeResult(const Ordering &ordering, ScoringWorkspace &ws) const;
+    SearchResult hillClimb(const Ordering &ordering, ScoringWorkspace &ws, Rng &rng, Deadline &deadline);
+    SearchResult hillClimb(const Ordering &ordering, float timeLimit, ResultRegister &rr, ScoringWorkspace &ws, Rng &rng);
     SearchResult ILS(const Ordering &ordering, int MAX_PERTURBS, int IMPROVE_THRESHHOLD, int PERTURB_FACTOR, float updateTolerance, ResultRegister &rr, float timeLimit, Types::Score opt);
     SearchResult tabuSearch(const Ordering &ordering, float timeLimit, int listSize, int softThreshold, ResultRegister &rr);
     SearchResult tabuSearchWithNRestarts(float timeLimit, int listSize, int softThreshold, ResultRegister &rr, Types::Score opt);
     SearchResult hillClimbingWithNRestarts(int numRestarts, ResultRegister &rr) ;
     SearchResult ILSWithNRestarts(float timeLimit, int greediness, int MAX_PERTURBS, int IMPROVE_THRESHHOLD, int PERTURB_FACTOR, float updateTolerance, ResultRegister &rr, Types::Score opt);
-    Types::Score findBestScoreRange(const Ordering &o, int start, int end);
+    Types::Score findBestScoreRange(const Ordering &o, int start, int end, ScoringWorkspace &ws);
     SearchResult simulatedAnnealing(double initTemp, int numSteps, float decay, float timeLimit, Types::Score opt, Neighbours neighbour, ResultRegister &rr);
     SearchResult simulatedAnnealingStepsSwap(Ordering &o, double initTemp, int maxSteps, float decay, float timeLimit, ResultRegister &rr);
     SearchResult simulatedAnnealingStepsInsert(Ordering &o, double initTemp, int maxSteps, float decay, float timeLimit, ResultRegister &rr);
     std::vector<int> bestParentIds(const Ordering &ordering);
     Ordering depthSort(const Ordering &ordering);
-    SearchResult genetic(float cutoffTime, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS, int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, Types::Score opt, ResultRegister &rr);
-    int getDepth(int m, const std::vector<int> &depth, const Ordering &o, const ParentSet &parent);
+    SearchResult genetic(float cutoffTime, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS, int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, Types::Score opt, ResultRegister &rr, int numThreads = 1,
+        int climbCacheSize = ClimbCache::DEFAULT_CAPACITY);
+    SearchResult islands(float cutoffTime, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS, int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType, int greediness, ResultRegister &rr,
+        int numThreads, int numIslands, int MIGRATION_INTERVAL, int NUM_MIGRANTS, bool randomTopology, int climbCacheSize = ClimbCache::DEFAULT_CAPACITY);
     SearchResult kollerSearch(Ordering &o, int listSize, float timeLimit, ResultRegister &rr);
     SearchResult kollerSearchRestarts(int listSize, float timeLimit, Types::Score opt, ResultRegister &rr);
     SearchResult hillClimbBestImprove(Ordering ordering, float cutoff, ResultRegister &rr);
@@ -69,10 +91,21 @@ class LocalSearch {
     SearchResult hillClimbFirstImproveV2(Ordering ordering, float cutoffTime, ResultRegister &rr);
     SearchResult hillClimbWithRestartsProbe(SelectType type, int numRuns, float cutoffTime, ResultRegister &rr, int greediness = -1);
     SearchResult kollerSearchV2(Ordering &o, int listSize, float timeLimit, ResultRegister &rr);
-    FastPivotResult getInsertScore(Ordering o, int i, int j, Types::Score initScore, std::vector<int> parents, std::vector<Types::Score> scores);
+    // Score change of swapping positions i < j, without changing o; apply
+    // the swap with applySwap.
+    Types::Score getSwapDelta(Ordering &o, int i, int j, ScoringWorkspace &ws);
+    void applySwap(Ordering &o, int i, int j, ScoringWorkspace &ws) const;
+    // Scores moving position i to j without changing o; apply the move with
+    // applyBestInsert and the returned index. Moves that end up more than
+    // maxDelta above initScore may be cut short, with a score that says so.
+    FastPivotResult getInsertScore(Ordering &o, int i, int j, Types::Score initScore, ScoringWorkspace &ws, Types::Score maxDelta = Types::SCORE_MAX);
     void checkSolution(const Ordering &o);
   private:
+    void reportClimbCache(long hits, long lookups);
+    Types::Score bestWithParent(int var, int parent) const;
+    void evolve(Population &population, std::deque<Types::Score> &fitnesses, int INIT_POPULATION_SIZE, int NUM_CROSSOVERS, int NUM_MUTATIONS, int MUTATION_POWER, int DIV_LOOKAHEAD, int NUM_KEEP, float DIV_TOLERANCE, CrossoverType crossoverType);
     const Instance &instance;
+    Rng rng;
 };
 
 #endif /* LOCALSEARCH_H */
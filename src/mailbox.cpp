@@ -0,0 +1,54 @@
+#include "mailbox.h"
+#include "debug.h"
+
+Mailbox::Mailbox(int capacity) : tail(0), head(0) {
+  size_t size = 1;
+  while (size < (size_t)capacity) {
+    size *= 2;
+  }
+  slots.reset(new Slot[size]);
+  mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+// Slot i is free for the sender holding ticket t when its sequence is t, and
+// holds a value for the receiver holding ticket t when its sequence is t + 1.
+bool Mailbox::send(const SearchResult &sr) {
+  size_t pos = tail.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = slots[pos & mask];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        slot.value = sr;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos) {
+      return false;
+    } else {
+      pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Mailbox::receive(SearchResult &sr) {
+  size_t pos = head.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = slots[pos & mask];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == pos + 1) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        sr = slot.value;
+        slot.sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos + 1) {
+      return false;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+}
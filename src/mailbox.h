@@ -0,0 +1,36 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+#include <memory>
+#include "searchresult.h"
+
+// Bounded lock-free queue of specimens, used by islands to pass migrants.
+// Any thread may send or receive. Each slot carries a sequence number that
+// tells senders and receivers whose turn it is (Vyukov's bounded MPMC queue),
+// so neither side ever blocks; a send to a full mailbox drops the migrant.
+class Mailbox {
+  public:
+    // capacity is rounded up to a power of two.
+    Mailbox(int capacity);
+    bool send(const SearchResult &sr);
+    bool receive(SearchResult &sr);
+  private:
+    Mailbox(const Mailbox &);
+    Mailbox &operator=(const Mailbox &);
+    struct Slot {
+      std::atomic<size_t> sequence;
+      SearchResult value;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    // Senders and receivers advance different counters; keep them on
+    // separate cache lines.
+    char padBefore[64];
+    std::atomic<size_t> tail;
+    char padBetween[64];
+    std::atomic<size_t> head;
+    char padAfter[64];
+};
+
+#endif /* MAILBOX_H */
@@ -1,17 +1,23 @@
 #include<iostream>
+#include <algorithm>
 #include <string>
+#include <thread>
 #include<fstream>
 #include <sys/time.h>
+#include <signal.h>
 #include<stdlib.h>
 #include "instance.h"
+#include "instanceimage.h"
 #include "ordering.h"
 #include "localsearch.h"
 #include "debug.h"
 #include "resultregister.h"
+#include "deadline.h"
 #include <unistd.h>
 #include "util.h"
 #include "types.h"
 #include "math.h"
+#include "subsetkernel.h"
 
 void usage() {
   std::cerr <<
@@ -21,11 +27,79 @@ void usage() {
     "Full command (with all optional arguments): \n\n" <<
     "\t./search  <instance-file> <cutofftime> <seed> <output file> -populationsize <pop size>\n\t-crossover <# of crossovers> -nummutation <# of mutations>\n\t-divlookahead <check paper> -numkeep <check paper>\n\t-crossovertype <check paper> -powerfactor <check paper>\n\n" <<
     "By default, the tuned parameters in the paper are used.\n" <<
+    "-simd <scalar|avx2|avx512> overrides the subset test kernel picked from the CPU.\n" <<
+    "-consistency <masks|positions> overrides how parent sets are checked against an ordering\n" <<
+    "\t(positions is the default from " << Instance::POSITION_MODE_MIN_N << " variables on).\n" <<
+    "-prune drops parent sets for which a subset scores at least as well, and reports how many.\n" <<
+    "-greediness <k> starts from greedy orderings, each variable drawn from the k that can take\n" <<
+    "\tthe best parent sets (default -1: random orderings).\n" <<
+    "-threads <k> parses the instance and climbs offspring on k threads (default: one per core).\n" <<
+    "-islands <k> evolves k populations in parallel, which exchange their best specimens\n" <<
+    "\tevery -migrationinterval <generations> (default 10) generations; -migrants <m> (default 2)\n" <<
+    "\tspecimens go to the next island, or to a random one with -topology random.\n" <<
+    "-climbcache <entries> remembers about that many climbs (default " << ClimbCache::DEFAULT_CAPACITY << ", 0 disables)\n" <<
+    "\tso that children repeating an ordering already climbed are not climbed again.\n\n" <<
+    "To preprocess an instance once and load it near instantly afterwards:\n\n" <<
+    "\t./search --compile-instance <instance-file> <image-file> [-consistency <masks|positions>] [-prune] [-threads <k>]\n\n" <<
+    "The image can then be given as <instance-file>.\n" <<
     "The result is printed to std::out at the end and a file with progress is dumped.\n\n" <<
     "For more information, feel free to contact me at cdlee@edu.uwaterloo.ca.\n";
 } 
 
-int main(int argc, char* argv[]) {
+// The search stops at its next check and the best result so far is dumped as
+// usual. A second signal kills the process.
+void interrupt(int) {
+  Deadline::cancel();
+}
+
+void catchInterrupts() {
+  struct sigaction action;
+  action.sa_handler = interrupt;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESETHAND;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+}
+
+// Parses instanceFile and writes its preprocessed binary image to imageFile.
+int compileInstance(const std::string &instanceFile, const std::string &imageFile, int positionMode, bool prune, int numThreads) {
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  Instance instance(instanceFile, positionMode, prune, numThreads);
+  if (prune) {
+    instance.reportPruning(std::cout);
+  }
+  instance.writeImage(imageFile);
+  gettimeofday(&end, NULL);
+  std::cout << "Compiled " << instanceFile << " (n = " << instance.getN() << ", " <<
+    instance.getStore().getSize() << " parent sets) into " << imageFile << " in " <<
+    (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6 << " s (parsed at " <<
+    instance.getParseThroughput() << " MB/s)" << std::endl;
+  return 0;
+}
+
+int run(int argc, char* argv[]) {
+  if (argc >= 4 && std::string(argv[1]) == "--compile-instance") {
+    int positionMode = -1;
+    bool prune = false;
+    int numThreads = std::thread::hardware_concurrency();
+    for (int i = 4; i < argc; i++) {
+      if (std::string(argv[i]) == "-consistency" && i + 1 < argc) {
+        std::string mode = argv[i+1];
+        if (mode != "masks" && mode != "positions") {
+          std::cerr << "Unknown -consistency mode " << mode << std::endl << std::endl;
+          usage();
+          return 1;
+        }
+        positionMode = mode == "positions" ? 1 : 0;
+      } else if (std::string(argv[i]) == "-prune") {
+        prune = true;
+      } else if (std::string(argv[i]) == "-threads" && i + 1 < argc) {
+        numThreads = atoi(argv[i+1]);
+      }
+    }
+    return compileInstance(argv[2], argv[3], positionMode, prune, numThreads);
+  }
   if (argc < 5) {
     usage();
     return 0;
@@ -37,11 +111,42 @@ int main(int argc, char* argv[]) {
   std::string outFile = argv[4];
   seed = seed == -1 ? time(NULL) : seed;
   ResultRegister rr;
-  srand(seed);
-  Instance instance(fileName);
+  // The consistency check and pruning decide the instance layout, and the
+  // threads also load it, so they are read before loading.
+  int positionMode = -1;
+  bool prune = false;
+  int numThreads = std::thread::hardware_concurrency();
+  for (int i = 5; i < argc; i++) {
+    if (std::string(argv[i]) == "-consistency" && i + 1 < argc) {
+      std::string mode = argv[i+1];
+      if (mode != "masks" && mode != "positions") {
+        std::cerr << "Unknown -consistency mode " << mode << std::endl << std::endl;
+        usage();
+        return 1;
+      }
+      positionMode = mode == "positions" ? 1 : 0;
+    } else if (std::string(argv[i]) == "-prune") {
+      prune = true;
+    } else if (std::string(argv[i]) == "-threads" && i + 1 < argc) {
+      numThreads = atoi(argv[i+1]);
+    }
+  }
+  // Images are loaded as compiled, so they can only be pruned when compiled.
+  if (prune && InstanceImage::isImage(fileName)) {
+    std::cerr << "-prune is ignored for the image " << fileName << "; prune with --compile-instance <instance-file> " <<
+      fileName << " -prune" << std::endl;
+    prune = false;
+  }
+  Instance instance(fileName, positionMode, prune, numThreads);
+  if (prune) {
+    instance.reportPruning(std::cerr);
+  }
+  if (instance.getParseThroughput() > 0) {
+    std::cerr << "Parsed " << fileName << " at " << instance.getParseThroughput() << " MB/s" << std::endl;
+  }
   rr.setOrigin();
   rr.set();
-  LocalSearch localSearch(instance);
+  LocalSearch localSearch(instance, seed);
   int n = instance.getN();
   int initPopulationSize = 20;
   int numCrossovers = 20;
@@ -52,7 +157,12 @@ int main(int argc, char* argv[]) {
   float divTolerance = 0.001;
   int greediness = -1;
   CrossoverType crossoverType = CrossoverType::OB;
-  for (int i = 5; i < 22 && i < argc; i++) {
+  int numIslands = 1;
+  int migrationInterval = 10;
+  int numMigrants = 2;
+  bool randomTopology = false;
+  int climbCacheSize = ClimbCache::DEFAULT_CAPACITY;
+  for (int i = 5; i + 1 < argc; i++) {
     std::string param(argv[i]);
     DBG(argv[i]);
     if (param == "-populationsize") {
@@ -69,6 +179,11 @@ int main(int argc, char* argv[]) {
       divTolerance = atof(argv[i+1]);
     } else if (param == "-greediness") {
       greediness = atoi(argv[i+1]);
+      if (greediness == 0 || greediness < -1) {
+        std::cerr << "-greediness must be -1 or at least 1, got " << argv[i+1] << std::endl << std::endl;
+        usage();
+        return 1;
+      }
     } else if (param == "-crossovertype") {
       std::string crossoverTypeString = argv[i+1];
       if (crossoverTypeString == "OB") {
@@ -81,10 +196,56 @@ int main(int argc, char* argv[]) {
     } else if (param == "-powerfactor") {
       float powerfactor = atof(argv[i+1]);
       mutationPower = ceil(n*powerfactor);
+    } else if (param == "-islands") {
+      numIslands = std::max(1, atoi(argv[i+1]));
+    } else if (param == "-migrationinterval") {
+      migrationInterval = std::max(1, atoi(argv[i+1]));
+    } else if (param == "-migrants") {
+      numMigrants = atoi(argv[i+1]);
+    } else if (param == "-climbcache") {
+      climbCacheSize = atoi(argv[i+1]);
+    } else if (param == "-topology") {
+      randomTopology = std::string(argv[i+1]) == "random";
+    } else if (param == "-simd") {
+      std::string level = argv[i+1];
+      bool supported = true;
+      if (level == "scalar") {
+        supported = SubsetKernel::setLevel(SubsetKernel::SCALAR);
+      } else if (level == "avx2") {
+        supported = SubsetKernel::setLevel(SubsetKernel::AVX2);
+      } else if (level == "avx512") {
+        supported = SubsetKernel::setLevel(SubsetKernel::AVX512);
+      } else {
+        std::cerr << "Unknown -simd level " << level << std::endl << std::endl;
+        usage();
+        return 1;
+      }
+      if (!supported) {
+        std::cerr << "SIMD level " << level << " is not supported on this CPU, using " << SubsetKernel::getName() << std::endl;
+      }
     }
   }
-  SearchResult sr = localSearch.genetic(cutoffTime, initPopulationSize, numCrossovers, numMutations, mutationPower, divLookahead, numKeep, divTolerance, crossoverType, greediness, opt, rr);
+  catchInterrupts();
+  SearchResult sr;
+  if (numIslands > 1) {
+    sr = localSearch.islands(cutoffTime, initPopulationSize, numCrossovers, numMutations, mutationPower, divLookahead, numKeep, divTolerance, crossoverType, greediness, rr,
+        numThreads, numIslands, migrationInterval, numMigrants, randomTopology, climbCacheSize);
+  } else {
+    sr = localSearch.genetic(cutoffTime, initPopulationSize, numCrossovers, numMutations, mutationPower, divLookahead, numKeep, divTolerance, crossoverType, greediness, opt, rr, numThreads, climbCacheSize);
+  }
+  if (Deadline::isCancelled()) {
+    std::cerr << "Interrupted at " << rr.check() << " s, keeping the best result so far" << std::endl;
+  }
   localSearch.checkSolution(sr.getOrdering());
   rr.dump(outFile, fileName, argc, argv, sr);
   return 0;
 }
+
+int main(int argc, char* argv[]) {
+  try {
+    return run(argc, argv);
+  } catch (const char *error) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,34 @@
+#include "mappedfile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &fileName) : begin(NULL), length(0) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw "Could not open file";
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw "Could not open file";
+  }
+  length = st.st_size;
+  if (length == 0) {
+    close(fd);
+    return;
+  }
+  void *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw "Could not map file";
+  }
+  begin = (const char *)mapped;
+}
+
+MappedFile::~MappedFile() {
+  if (begin) {
+    munmap((void *)begin, length);
+  }
+}
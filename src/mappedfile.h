@@ -0,0 +1,21 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+  public:
+    MappedFile(const std::string &fileName);
+    ~MappedFile();
+    const char *data() const { return begin; }
+    size_t size() const { return length; }
+  private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+    const char *begin;
+    size_t length;
+};
+
+#endif /* MAPPEDFILE_H */
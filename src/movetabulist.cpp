@@ -1,16 +1,27 @@
 #include "movetabulist.h"
 #include "debug.h"
 
-MoveTabuList::MoveTabuList(int size, int n) : MAX_SIZE(size), bucketSizes(n) { }
+MoveTabuList::MoveTabuList(int size, int n) : MAX_SIZE(size), n(n), bucketSizes(n) {
+  moveCounts.reserve(size + 1);
+}
+
+void MoveTabuList::release(int id, int index) {
+  std::unordered_map<uint64_t, int>::iterator it = moveCounts.find(key(id, index));
+  if (--it->second == 0) {
+    moveCounts.erase(it);
+  }
+}
 
 void MoveTabuList::add(int id, int index) {
   _list.push_back(std::make_pair(id, index));
+  ++bucketSizes[id];
+  ++moveCounts[key(id, index)];
   if (_list.size() > MAX_SIZE) {
     std::pair<int, int> popped = _list.front();
     --bucketSizes[popped.first];
+    release(popped.first, popped.second);
     _list.pop_front();
   }
-  ++bucketSizes[id];
   /*
   for (int i = 0; i < _list.size(); i++) {
     DBG(_list[i].first << " " << _list[i].second);
@@ -22,16 +33,9 @@ void MoveTabuList::add(int id, int index) {
 }
 
 bool MoveTabuList::contains(const Ordering &o) {
-  int n = o.getSize();
-  int lsize = _list.size();
-  for (int i = 0; i < n; i++) {
-    int num = o.get(i);
-    if (bucketSizes[num] > 0) {
-      for (int j = 0; j < lsize; j++) {
-        if (_list[j].first == num && _list[j].second == i) {
-          return true;
-        }
-      }
+  for (std::unordered_map<uint64_t, int>::const_iterator it = moveCounts.begin(); it != moveCounts.end(); ++it) {
+    if (o.get((uint32_t)it->first) == (int)(it->first >> 32)) {
+      return true;
     }
   }
   return false;
@@ -39,4 +43,4 @@ bool MoveTabuList::contains(const Ordering &o) {
 
 bool MoveTabuList::contains(int i) {
   return bucketSizes[i] > 0;
-}
\ No newline at end of file
+}
@@ -1,10 +1,15 @@
 #include<deque>
+#include<unordered_map>
+#include<stdint.h>
 #include "ordering.h"
 #include "util.h"
 
 #ifndef MOVETABULIST_H
 #define MOVETABULIST_H 
 
+// The last MAX_SIZE moves of a variable to an index. Counts per variable and
+// per (variable, index) pair answer lookups without scanning the list; pairs
+// are hashed so memory follows the tenure rather than n * n.
 class MoveTabuList {
   public:
     int MAX_SIZE;
@@ -14,7 +19,12 @@ class MoveTabuList {
     bool contains(int i);
   private:
     std::deque<std::pair<int, int>> _list;
+    int n;
     std::vector<int> bucketSizes;
+    // Nonzero counts only, by key(id, index).
+    std::unordered_map<uint64_t, int> moveCounts;
+    static uint64_t key(int id, int index) { return (uint64_t)id << 32 | (uint32_t)index; }
+    void release(int id, int index);
 };
 
-#endif /* MOVETABULIST_H */
\ No newline at end of file
+#endif /* MOVETABULIST_H */
@@ -1,12 +1,25 @@
 #include"ordering.h"
 #include<algorithm>
+#include<functional>
 #include"debug.h"
-Ordering::Ordering(int size) : size(size) {
+#include"rng.h"
+
+// Zobrist key of var at index. Variable 0 has none, so that the zero filled
+// Ordering(size) hashes to 0; where the other variables are still fixes a
+// permutation.
+static inline uint64_t key(int var, int index) {
+  return var == 0 ? 0 : Rng::hash(((uint64_t)var << 32) | (uint32_t)index);
+}
+
+Ordering::Ordering(int size) : size(size), hash(0) {
   ordering.resize(size);
+  positions.resize(size);
 }
 
 void Ordering::set(const int &index, const int &num) {
+  hash ^= key(ordering[index], index) ^ key(num, index);
   ordering[index] = num;
+  positions[num] = index;
 }
 
 int Ordering::get(const int &index) const {
@@ -20,38 +33,122 @@ std::ostream& operator<<(std::ostream& os, const Ordering&o) {
 }
 
 void Ordering::swap(const int &i, const int &j) {
-  std::swap(ordering[i], ordering[j]);
+  int a = ordering[i];
+  int b = ordering[j];
+  hash ^= key(a, i) ^ key(b, j) ^ key(a, j) ^ key(b, i);
+  swapUnhashed(i, j);
 }
 
-Ordering Ordering::greedyOrdering(const Instance &instance, int greediness) {
+// Score of the best consistent set of a variable, and the variable.
+typedef std::pair<Types::Score, int> Candidate;
+
+// Each unplaced variable keeps best, the rank of its best parent set
+// consistent with the placed prefix. Placing u can only unblock sets that
+// contain u, so best moves only for the variables with such a set ranked
+// before it, and only those sets are searched. The greediness best variables
+// are kept in top, the others in a min heap on the score of their best set
+// whose stale entries are dropped when they reach the front. Each position
+// is drawn uniformly from top.
+Ordering Ordering::greedyOrdering(const Instance &instance, int greediness, Rng &rng) {
   int n = instance.getN();
+  const ParentSetStore &store = instance.getStore();
+  Types::Bitset pred(n, 0);
+  std::vector<int> best(n);
+  std::vector<Candidate> heap;
+  std::greater<Candidate> after;
+  for (int v = 0; v < n; v++) {
+    const Variable &var = instance.getVar(v);
+    best[v] = var.firstConsistent(pred);
+    if (best[v] != -1) {
+      heap.push_back(Candidate(var.getParent(best[v]).getScore(), v));
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), after);
+  auto popStale = [&]() {
+    while (!heap.empty()) {
+      int v = heap.front().second;
+      if (!pred[v] && heap.front().first == store.getScore(instance.getVar(v).getOffset() + best[v])) {
+        return;
+      }
+      std::pop_heap(heap.begin(), heap.end(), after);
+      heap.pop_back();
+    }
+  };
+  std::vector<Candidate> top;
+  // Index in top of each variable, or -1.
+  std::vector<int> slot(n, -1);
   Ordering o(n);
   for (int i = 0; i < n; i++) {
-    int v = o.findSmallestConsistentWithOrderingRandom(i, instance, greediness);
-    o.set(i, v);
+    for (popStale(); (int)top.size() < greediness && !heap.empty(); popStale()) {
+      slot[heap.front().second] = top.size();
+      top.push_back(heap.front());
+      std::pop_heap(heap.begin(), heap.end(), after);
+      heap.pop_back();
+    }
+    // Variables that improved past the worst of top take its place.
+    for (popStale(); !top.empty() && !heap.empty(); popStale()) {
+      int worst = std::max_element(top.begin(), top.end()) - top.begin();
+      if (!after(top[worst], heap.front())) {
+        break;
+      }
+      Candidate c = heap.front();
+      std::pop_heap(heap.begin(), heap.end(), after);
+      heap.back() = top[worst];
+      std::push_heap(heap.begin(), heap.end(), after);
+      slot[top[worst].second] = -1;
+      slot[c.second] = worst;
+      top[worst] = c;
+    }
+    if (top.empty()) {
+      throw "No parent set is consistent with the ordering";
+    }
+    int u = top[rng.uniform(top.size())].second;
+    top[slot[u]] = top.back();
+    slot[top.back().second] = slot[u];
+    top.pop_back();
+    slot[u] = -1;
+    pred[u] = 1;
+    o.set(i, u);
+    // Only variables with a parent set containing u can gain a set.
+    for (int v : instance.getChildren(u)) {
+      if (pred[v]) {
+        continue;
+      }
+      int limit = best[v] == -1 ? instance.getVar(v).numParents() : best[v];
+      ParentList withU = store.withParent(v, u);
+      if (withU[0] >= limit) {
+        continue;
+      }
+      const Variable &var = instance.getVar(v);
+      int j = var.firstConsistentWithParent(pred, u, limit);
+      if (j == -1) {
+        continue;
+      }
+      Types::Score score = var.getParent(j).getScore();
+      if (slot[v] != -1) {
+        top[slot[v]].first = score;
+      } else if (best[v] == -1 || score < var.getParent(best[v]).getScore()) {
+        // An equal score keeps the entry already in the heap valid.
+        heap.push_back(Candidate(score, v));
+        std::push_heap(heap.begin(), heap.end(), after);
+      }
+      best[v] = j;
+    }
   }
   return o;
 }
 
-Ordering Ordering::greedyOrdering(const Instance &instance) {
-  int greediness = 10;
-  int n = instance.getN();
-  Ordering o(n);
-  for (int i = 0; i < n; i++) {
-    int v = o.findSmallestConsistentWithOrderingRandom(i, instance, greediness);
-    o.set(i, v);
-  }
-  return o;
+Ordering Ordering::greedyOrdering(const Instance &instance, Rng &rng) {
+  return greedyOrdering(instance, 10, rng);
 }
 
-Ordering Ordering::randomOrdering(const Instance &instance) {
-  int greediness = 10;
+Ordering Ordering::randomOrdering(const Instance &instance, Rng &rng) {
   int n = instance.getN();
   std::vector<int> shuffled;
   for (int i = 0; i < n; i++) {
     shuffled.push_back(i);
   }
-  std::random_shuffle(shuffled.begin(), shuffled.end());
+  rng.shuffle(shuffled.begin(), shuffled.end());
   Ordering o(n);
   for (int i = 0; i < n; i++) {
     o.set(i, shuffled[i]);
@@ -70,74 +167,50 @@ int Ordering::findSmallestConsistentWithOrdering(const int &m, const Instance &i
   Types::Score minCost = Types::SCORE_MAX; // I assume this is sufficiently large
   for (int i = 0; i < n; i++) {
     if (!current[i]) {
+      // Parent sets are in score order, so the first consistent one is the cheapest.
       const Variable &v = instance.getVar(i);
-      int numParents = v.numParents();
-      for (int j = 0; j < numParents; j++) {
-        const ParentSet &parentSet = v.getParent(j);
-        if (parentSet.subsetOf(current) && parentSet.getScore() < minCost) {
-          minVar = i;
-          minCost = parentSet.getScore();
-        }
+      int j = v.firstConsistent(current);
+      if (j != -1 && v.getParent(j).getScore() < minCost) {
+        minVar = i;
+        minCost = v.getParent(j).getScore();
       }
     }
   }
   return minVar;
 }
 
-int Ordering::findSmallestConsistentWithOrderingRandom(const int &m, const Instance &instance, int MAX_HEAP_SIZE) {
-  int n = instance.getN();
-  std::vector<const ParentSet*> heap;
-
-  Types::Bitset current(n, 0);
-  // Flag nodes that are already seen
-  for (int i = 0; i < m; i++) {
-    current[ordering[i]] = 1;
-  }
-  for (int i = 0; i < n; i++) {
-    if (!current[i]) {
-      const Variable &v = instance.getVar(i);
-      int numParents = v.numParents();
-      for (int j = 0; j < numParents; j++) {
-        const ParentSet *parentSet = &(v.getParent(j));
-        if (parentSet->subsetOf(current)) {
-          heap.push_back(parentSet);
-          std::push_heap(heap.begin(), heap.end(), [](const ParentSet* a, const ParentSet* b) {
-            return a->getScore() < b->getScore();
-          });
-          if (heap.size() > MAX_HEAP_SIZE) {
-            std::pop_heap(heap.begin(), heap.end(), [](const ParentSet* a, const ParentSet* b) {
-              return a->getScore() < b->getScore();
-            });
-            heap.pop_back();
-          }
-          break;
-        }
-      }
-    }
+void Ordering::insert(const int &i, const int &j) {
+  hash ^= key(ordering[i], i) ^ key(ordering[i], j);
+  for (int k = std::min(i, j); k < std::max(i, j); k++) {
+    // The variables between shift by one, towards i.
+    int shifted = i < j ? k + 1 : k;
+    hash ^= key(ordering[shifted], k) ^ key(ordering[shifted], k + 1);
   }
-  const ParentSet *chosen = heap[rand()%heap.size()];
-  return chosen->getVar();
+  insertUnhashed(i, j);
 }
 
-void Ordering::insert(const int &i, const int &j) {
+void Ordering::insertUnhashed(const int &i, const int &j) {
+  int temp = ordering[i];
   if (i < j) {
-    int temp = ordering[i];
     for (int k = i; k < j; k++) {
       ordering[k] = ordering[k+1];
+      positions[ordering[k]] = k;
     }
     ordering[j] = temp;
   } else {
-    int temp = ordering[i];
     for (int k = i; k > j; k--) {
       ordering[k] = ordering[k-1];
+      positions[ordering[k]] = k;
     }
     ordering[j] = temp;
   }
+  positions[ordering[j]] = j;
 }
 
-void Ordering::perturb(int PERTURB_FACTOR) {
+void Ordering::perturb(int PERTURB_FACTOR, Rng &rng) {
   for (int i = 0; i < PERTURB_FACTOR; i++) {
-    swap(rand()%size, rand()%size);
+    int a = rng.uniform(size);
+    swap(a, rng.uniform(size));
   }
 }
 
@@ -146,6 +219,9 @@ int Ordering::getSize() const {
 }
 
 bool Ordering::equals(const Ordering &o) const {
+  if (hash != o.hash) {
+    return false;
+  }
   for (int i = 0; i < size; i++) {
     if (this->get(i) != o.get(i)) {
       return false;
@@ -1,29 +1,46 @@
 #ifndef ORDERING_H
 #define ORDERING_H 
+#include<algorithm>
+#include<cstdint>
 #include<iostream>
 #include<vector>
 #include"instance.h"
+#include "rng.h"
 #include "types.h"
+// Orderings carry a Zobrist hash, kept up to date by set, swap and insert:
+// the xor over positions of a key for the variable at that position.
 class Ordering {
   public:
-    Ordering() {}
+    Ordering() : size(0), hash(0) {}
     Ordering(int size);
     void set(const int &index, const int &num);
     int get(const int &index) const;
     friend std::ostream& operator<<(std::ostream &os, const Ordering& o);
     void swap(const int &i, const int &j);
-    static Ordering greedyOrdering(const Instance &instance);
-    static Ordering greedyOrdering(const Instance &instance, int greediness);
-    static Ordering randomOrdering(const Instance &instance);
+    static Ordering greedyOrdering(const Instance &instance, Rng &rng);
+    static Ordering greedyOrdering(const Instance &instance, int greediness, Rng &rng);
+    static Ordering randomOrdering(const Instance &instance, Rng &rng);
     int findSmallestConsistentWithOrdering(const int &i, const Instance &instance);
-    int findSmallestConsistentWithOrderingRandom(const int &i, const Instance &instance, int greediness);
     void insert(const int &i, const int &j);
-    void perturb(int PERTURB_FACTOR);
+    // swap and insert without the hash update, for moves that are undone
+    // before the hash is read again.
+    void swapUnhashed(const int &i, const int &j) {
+      std::swap(ordering[i], ordering[j]);
+      positions[ordering[i]] = i;
+      positions[ordering[j]] = j;
+    }
+    void insertUnhashed(const int &i, const int &j);
+    void perturb(int PERTURB_FACTOR, Rng &rng);
     int getSize() const;
     bool equals(const Ordering &o) const;
+    uint64_t getHash() const { return hash; }
+    int getPosition(int var) const { return positions[var]; }
+    const int *getPositions() const { return positions.data(); }
   private:
     std::vector<int> ordering;
+    std::vector<int> positions;
     int size;
+    uint64_t hash;
 };
 
 #endif /* ORDERING_H */
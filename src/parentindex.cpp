@@ -0,0 +1,121 @@
+#include "parentindex.h"
+#include <algorithm>
+#include "debug.h"
+
+ParentIndex::ParentIndex() : ownParentOffsets(1, 0), ownBitOffsets(1, 0) {
+  refresh();
+}
+
+int ParentIndex::add(const ParentSetStore &store, int begin, int m) {
+  int slot = ownCount.size();
+  int start = ownParents.size();
+  for (int r = 0; r < m; r++) {
+    ParentList list = store.getParents(begin + r);
+    ownParents.insert(ownParents.end(), list.begin(), list.end());
+  }
+  std::sort(ownParents.begin() + start, ownParents.end());
+  ownParents.erase(std::unique(ownParents.begin() + start, ownParents.end()), ownParents.end());
+  int k = ownParents.size() - start;
+  int words = (m + Types::BLOCK_BITS - 1) / Types::BLOCK_BITS;
+  // Word-major layout: the k words covering ranks [64w, 64w + 64) are adjacent.
+  size_t bitStart = ownBits.size();
+  ownBits.resize(bitStart + (size_t)words * k, ~(Types::Block)0);
+  for (int r = 0; r < m; r++) {
+    ParentList list = store.getParents(begin + r);
+    for (const int *it = list.begin(); it != list.end(); ++it) {
+      int j = std::lower_bound(ownParents.begin() + start, ownParents.end(), *it) - (ownParents.begin() + start);
+      ownBits[bitStart + (size_t)(r / Types::BLOCK_BITS) * k + j] &= ~((Types::Block)1 << (r % Types::BLOCK_BITS));
+    }
+  }
+  ownCount.push_back(m);
+  ownParentOffsets.push_back(ownParents.size());
+  ownBitOffsets.push_back(ownBits.size());
+  refresh();
+  return slot;
+}
+
+// Reads the index from arrays owned by the caller, which must outlive it.
+void ParentIndex::attach(int numSlots, const int *count, const int *parentOffsets, const int *parents,
+    const uint64_t *bitOffsets, const Types::Block *bits) {
+  this->numSlots = numSlots;
+  this->count = count;
+  this->parentOffsets = parentOffsets;
+  this->parents = parents;
+  this->bitOffsets = bitOffsets;
+  this->bits = bits;
+}
+
+void ParentIndex::refresh() {
+  numSlots = ownCount.size();
+  count = ownCount.data();
+  parentOffsets = ownParentOffsets.data();
+  parents = ownParents.data();
+  bitOffsets = ownBitOffsets.data();
+  bits = ownBits.data();
+}
+
+int ParentIndex::firstConsistent(int slot, const Types::Bitset &pred, int limit, int required) const {
+  const int *relevant = &parents[parentOffsets[slot]];
+  int k = parentOffsets[slot + 1] - parentOffsets[slot];
+  int requiredPos = -1;
+  if (required != -1) {
+    const int *found = std::lower_bound(relevant, relevant + k, required);
+    if (found == relevant + k || *found != required) {
+      return -1;
+    }
+    requiredPos = found - relevant;
+  }
+  limit = std::min(limit, count[slot]);
+  // Collect the rows of the relevant parents missing from pred once per query.
+  const int MAX_ACTIVE = 256;
+  int active[MAX_ACTIVE];
+  int numActive = 0;
+  bool overflow = false;
+  for (int j = 0; j < k; j++) {
+    if (!pred[relevant[j]]) {
+      if (numActive == MAX_ACTIVE) {
+        overflow = true;
+        break;
+      }
+      active[numActive++] = j;
+    }
+  }
+  const Types::Block *row = &bits[bitOffsets[slot]];
+  int words = (limit + Types::BLOCK_BITS - 1) / Types::BLOCK_BITS;
+  for (int w = 0; w < words; w++, row += k) {
+    Types::Block acc = ~(Types::Block)0;
+    if (w == words - 1 && limit % Types::BLOCK_BITS) {
+      acc = ((Types::Block)1 << (limit % Types::BLOCK_BITS)) - 1;
+    }
+    if (requiredPos != -1) {
+      acc &= ~row[requiredPos];
+    }
+    if (overflow) {
+      for (int j = 0; j < k && acc; j++) {
+        if (!pred[relevant[j]]) {
+          acc &= row[j];
+        }
+      }
+    } else {
+      for (int a = 0; a < numActive && acc; a++) {
+        acc &= row[active[a]];
+      }
+    }
+    if (acc) {
+      return w * Types::BLOCK_BITS + __builtin_ctzll(acc);
+    }
+  }
+  return -1;
+}
+
+int ParentIndex::numRelevant(int slot) const {
+  return parentOffsets[slot + 1] - parentOffsets[slot];
+}
+
+// A word of the index covers 64 ranks for one AND per missing parent, while the
+// vectorized scan pays roughly one operation per eight single-word masks or per
+// wider mask. The index wins when the variable has few distinct parents
+// relative to the mask width.
+bool ParentIndex::prefersIndex(int slot, int numBlocks) const {
+  return count[slot] >= Types::BLOCK_BITS && numRelevant(slot) < 8 * numBlocks;
+}
@@ -0,0 +1,49 @@
+#ifndef PARENTINDEX_H
+#define PARENTINDEX_H
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "parentsetstore.h"
+
+// Bit-vector intersection index over the score-sorted parent sets of each
+// variable. For every parent u that occurs in some set of a variable, the
+// index keeps a bit-vector over the ranks of that variable's sets with bit r
+// set iff set r does not contain u. The best set consistent with pred is the
+// first set bit of the AND over all u not in pred, which is evaluated one
+// word (64 ranks) at a time and stops at the first non-empty word.
+// Like ParentSetStore, the arrays are owned or borrowed from an instance image.
+class ParentIndex {
+  public:
+    ParentIndex();
+    int add(const ParentSetStore &store, int begin, int count);
+    void attach(int numSlots, const int *count, const int *parentOffsets, const int *parents,
+        const uint64_t *bitOffsets, const Types::Block *bits);
+    // Rank of the best set of slot consistent with pred among ranks < limit
+    // that contains required (ignored if -1), or -1.
+    int firstConsistent(int slot, const Types::Bitset &pred, int limit, int required) const;
+    int numRelevant(int slot) const;
+    bool prefersIndex(int slot, int numBlocks) const;
+    // Raw arrays, for writing an instance image.
+    int getNumSlots() const { return numSlots; }
+    const int *countData() const { return count; }
+    const int *offsetData() const { return parentOffsets; }
+    const int *parentData() const { return parents; }
+    const uint64_t *bitOffsetData() const { return bitOffsets; }
+    const Types::Block *bitData() const { return bits; }
+  private:
+    void refresh();
+    int numSlots;
+    const int *count;
+    const int *parentOffsets;
+    const int *parents;
+    const uint64_t *bitOffsets;
+    const Types::Block *bits;
+    std::vector<int> ownCount;
+    std::vector<int> ownParentOffsets;
+    std::vector<int> ownParents;
+    std::vector<uint64_t> ownBitOffsets;
+    std::vector<Types::Block> ownBits;
+};
+
+#endif /* PARENTINDEX_H */
@@ -1,27 +1,27 @@
 #ifndef PARENTSET_H
 #define PARENTSET_H
 
-#include<boost/dynamic_bitset.hpp>
 #include<vector>
 #include "types.h"
+#include "parentsetstore.h"
 
+// Lightweight view of a parent set stored in a ParentSetStore.
 class ParentSet {
   public:
-    ParentSet(Types::Score score, Types::Bitset parents, int var, int id, std::vector<int> parentsVec);
-    Types::Score getScore() const;
-    bool hasElement(int k) const;
-    bool subsetOf(const Types::Bitset &set) const;
+    ParentSet(const ParentSetStore *store, int idx, int var, int id) :
+      store(store), idx(idx), var(var), id(id) { }
+    Types::Score getScore() const { return store->getScore(idx); }
+    bool hasElement(int k) const { return store->hasElement(idx, k); }
+    bool subsetOf(const Types::Bitset &set) const { return store->subsetOf(idx, set); }
     int getVar() const;
     int getId() const;
-    void setId(const int &i);
     friend std::ostream& operator<<(std::ostream &os, const ParentSet& p);
-    const std::vector<int> &getParentsVec() const;
+    ParentList getParentsVec() const;
   private:
-    Types::Score score;
-    Types::Bitset parents;
+    const ParentSetStore *store;
+    int idx;
     int var;
     int id;
-    std::vector<int> parentsVec;
 };
  
 #endif /* PARENTSET_H */
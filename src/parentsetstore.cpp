@@ -0,0 +1,188 @@
+#include "parentsetstore.h"
+#include "debug.h"
+
+ParentSetStore::ParentSetStore() : n(0), numBlocks(0), withMasks(true), size(0), ownParentOffsets(1, 0),
+  ownRowStart(1, 0), ownRowOffsets(1, 0) {
+  refresh();
+}
+
+void ParentSetStore::init(int n, int numSets, bool withMasks, size_t listSize) {
+  this->n = n;
+  this->withMasks = withMasks;
+  numBlocks = (n + Types::BLOCK_BITS - 1) / Types::BLOCK_BITS;
+  ownScores.clear();
+  ownMasks.clear();
+  ownParentOffsets.assign(1, 0);
+  ownParentList.clear();
+  ownScores.reserve(numSets);
+  if (withMasks) {
+    ownMasks.reserve((size_t)numSets * numBlocks);
+  }
+  ownParentOffsets.reserve(numSets + 1);
+  ownParentList.reserve(listSize);
+  ownRowStart.assign(n + 1, 0);
+  ownRowKeys.clear();
+  ownRowOffsets.assign(1, 0);
+  ownRowRanks.clear();
+  refresh();
+}
+
+int ParentSetStore::add(Types::Score score, const std::vector<int> &parentsVec) {
+  return add(score, parentsVec.data(), parentsVec.size());
+}
+
+int ParentSetStore::add(Types::Score score, const int *parents, int count) {
+  int idx = ownScores.size();
+  ownScores.push_back(score);
+  ownParentList.insert(ownParentList.end(), parents, parents + count);
+  if (withMasks) {
+    ownMasks.resize(ownMasks.size() + numBlocks, 0);
+    Types::Block *mask = &ownMasks[(size_t)idx * numBlocks];
+    for (int k = 0; k < count; k++) {
+      int parentVar = parents[k];
+      mask[parentVar / Types::BLOCK_BITS] |= (Types::Block)1 << (parentVar % Types::BLOCK_BITS);
+    }
+  }
+  ownParentOffsets.push_back(ownParentList.size());
+  refresh();
+  return idx;
+}
+
+void ParentSetStore::allocate(int n, int numSets, size_t listSize) {
+  init(n, 0, false);
+  ownScores.resize(numSets);
+  ownParentOffsets.resize(numSets + 1);
+  ownParentList.resize(listSize);
+  refresh();
+}
+
+// Ranges only move down, so copying forwards never overwrites unread data.
+void ParentSetStore::compact(int numRanges, int *begin, const int *count) {
+  int numSets = 0;
+  int listEnd = 0;
+  for (int i = 0; i < numRanges; i++) {
+    int first = begin[i];
+    int listBegin = ownParentOffsets[first];
+    std::copy(ownScores.begin() + first, ownScores.begin() + first + count[i], ownScores.begin() + numSets);
+    std::copy(ownParentList.begin() + listBegin, ownParentList.begin() + ownParentOffsets[first + count[i]],
+        ownParentList.begin() + listEnd);
+    for (int j = 1; j <= count[i]; j++) {
+      ownParentOffsets[numSets + j] = ownParentOffsets[first + j] - listBegin + listEnd;
+    }
+    begin[i] = numSets;
+    numSets += count[i];
+    listEnd = ownParentOffsets[numSets];
+  }
+  ownScores.resize(numSets);
+  ownParentOffsets.resize(numSets + 1);
+  ownParentList.resize(listEnd);
+  refresh();
+}
+
+void ParentSetStore::finish(bool withMasks) {
+  this->withMasks = withMasks;
+  if (withMasks) {
+    ownMasks.assign((size_t)size * numBlocks, 0);
+    for (int idx = 0; idx < size; idx++) {
+      Types::Block *mask = &ownMasks[(size_t)idx * numBlocks];
+      for (int p = ownParentOffsets[idx]; p < ownParentOffsets[idx + 1]; p++) {
+        int parentVar = ownParentList[p];
+        mask[parentVar / Types::BLOCK_BITS] |= (Types::Block)1 << (parentVar % Types::BLOCK_BITS);
+      }
+    }
+  }
+  refresh();
+}
+
+// Reads the store from arrays owned by the caller, which must outlive it.
+void ParentSetStore::attach(int n, int numSets, bool withMasks, const Types::Score *scores, const Types::Block *masks,
+    const int *parentOffsets, const int *parentList) {
+  init(n, 0, withMasks);
+  size = numSets;
+  this->scores = scores;
+  this->masks = withMasks ? masks : NULL;
+  this->parentOffsets = parentOffsets;
+  this->parentList = parentList;
+}
+
+// Rows of variable v are [rowStart[v], rowStart[v + 1]); row r lists
+// rowRanks[rowOffsets[r] .. rowOffsets[r + 1]).
+void ParentSetStore::buildParentLists(const int *setBegin, const int *setCount) {
+  bool dense = denseParentLists();
+  ownRowStart.assign(n + 1, 0);
+  ownRowKeys.clear();
+  ownRowOffsets.assign(1, 0);
+  ownRowRanks.assign(parentOffsets[size], 0);
+  std::vector<int> count(n, 0);
+  std::vector<int> next(n);
+  std::vector<int> keys;
+  if (dense) {
+    for (int u = 0; u < n; u++) {
+      keys.push_back(u);
+    }
+  }
+  int total = 0;
+  for (int v = 0; v < n; v++) {
+    int first = parentOffsets[setBegin[v]];
+    int last = parentOffsets[setBegin[v] + setCount[v]];
+    if (!dense) {
+      keys.clear();
+    }
+    for (int p = first; p < last; p++) {
+      if (count[parentList[p]]++ == 0 && !dense) {
+        keys.push_back(parentList[p]);
+      }
+    }
+    if (!dense) {
+      std::sort(keys.begin(), keys.end());
+      ownRowKeys.insert(ownRowKeys.end(), keys.begin(), keys.end());
+    }
+    // Counting sort by parent; ranks come out in score order within a row.
+    for (int u : keys) {
+      next[u] = total;
+      total += count[u];
+      count[u] = 0;
+      ownRowOffsets.push_back(total);
+    }
+    for (int r = 0; r < setCount[v]; r++) {
+      int idx = setBegin[v] + r;
+      for (int p = parentOffsets[idx]; p < parentOffsets[idx + 1]; p++) {
+        ownRowRanks[next[parentList[p]]++] = r;
+      }
+    }
+    ownRowStart[v + 1] = ownRowOffsets.size() - 1;
+  }
+  refresh();
+}
+
+void ParentSetStore::attachParentLists(const int *rowStart, const int *rowKeys, const int *rowOffsets, const int *rowRanks) {
+  this->rowStart = rowStart;
+  this->rowKeys = rowKeys;
+  this->rowOffsets = rowOffsets;
+  this->rowRanks = rowRanks;
+}
+
+// The owned vectors may reallocate on every add.
+void ParentSetStore::refresh() {
+  size = ownScores.size();
+  scores = ownScores.data();
+  masks = ownMasks.data();
+  parentOffsets = ownParentOffsets.data();
+  parentList = ownParentList.data();
+  rowStart = ownRowStart.data();
+  rowKeys = ownRowKeys.data();
+  rowOffsets = ownRowOffsets.data();
+  rowRanks = ownRowRanks.data();
+}
+
+int ParentSetStore::getSize() const {
+  return size;
+}
+
+int ParentSetStore::getNumBlocks() const {
+  return numBlocks;
+}
+
+int ParentSetStore::getN() const {
+  return n;
+}
@@ -0,0 +1,181 @@
+#ifndef PARENTSETSTORE_H
+#define PARENTSETSTORE_H
+
+#include <algorithm>
+#include <vector>
+#include "types.h"
+#include "subsetkernel.h"
+
+// Read-only view over the parent variables of a single parent set.
+class ParentList {
+  public:
+    ParentList(const int *first, const int *last) : first(first), last(last) { }
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+    int size() const { return last - first; }
+    int operator[](int i) const { return first[i]; }
+  private:
+    const int *first;
+    const int *last;
+};
+
+// Contiguous arena holding every parent set of an instance.
+// Parent sets are addressed by a global index; the sets of a variable occupy
+// a contiguous range of indices in score order, so a variable's parent set
+// of rank r lives at (offset of the variable) + r.
+// Scores, packed parent masks and parent lists (CSR) are kept in separate
+// arrays so that scans only touch the data they need.
+// Without masks (see Instance::usesPositions) only the parent lists are kept,
+// so memory scales with the total parent-set size instead of n per set, and
+// consistency is tested against the positions of an ordering.
+// The arrays are either owned (filled by add or in place) or borrowed from a mapped
+// instance image (see attach), and are read through the same pointers.
+//
+// For each variable the store also lists, per parent variable u, the ranks of
+// the variable's sets that contain u, in score order (CSR). Up to
+// DENSE_PARENT_LISTS_MAX_N variables the rows are indexed by u directly;
+// beyond that only parents that occur get a row, found through a sorted key.
+class ParentSetStore {
+  public:
+    static const int DENSE_PARENT_LISTS_MAX_N = 2048;
+    ParentSetStore();
+    void init(int n, int numSets, bool withMasks, size_t listSize = 0);
+    int add(Types::Score score, const std::vector<int> &parentsVec);
+    int add(Types::Score score, const int *parents, int count);
+    // Fills the store in place instead of through add: allocate sizes the
+    // owned arrays for numSets sets with listSize parents in all, the caller
+    // writes scores, parent lists and absolute offsets (offsets[0] is 0)
+    // through the mutable arrays, closes gaps with compact and calls finish.
+    void allocate(int n, int numSets, size_t listSize);
+    Types::Score *mutableScores() { return ownScores.data(); }
+    int *mutableOffsets() { return ownParentOffsets.data(); }
+    int *mutableList() { return ownParentList.data(); }
+    // Range i holds the sets [begin[i], begin[i] + count[i]), ranges in
+    // increasing order. Moves the ranges back to back and updates begin.
+    void compact(int numRanges, int *begin, const int *count);
+    // Builds the masks if withMasks.
+    void finish(bool withMasks);
+    void attach(int n, int numSets, bool withMasks, const Types::Score *scores, const Types::Block *masks,
+        const int *parentOffsets, const int *parentList);
+    // setBegin[v] and setCount[v] give the range of the sets of variable v.
+    void buildParentLists(const int *setBegin, const int *setCount);
+    void attachParentLists(const int *rowStart, const int *rowKeys, const int *rowOffsets, const int *rowRanks);
+    int getSize() const;
+    int getNumBlocks() const;
+    int getN() const;
+    bool hasMasks() const { return withMasks; }
+    // Raw arrays, for writing an instance image.
+    const Types::Score *scoreData() const { return scores; }
+    const Types::Block *maskData() const { return masks; }
+    const int *offsetData() const { return parentOffsets; }
+    const int *listData() const { return parentList; }
+    int getListSize() const { return parentOffsets[size]; }
+    bool denseParentLists() const { return n <= DENSE_PARENT_LISTS_MAX_N; }
+    const int *rowStartData() const { return rowStart; }
+    const int *rowKeyData() const { return rowKeys; }
+    const int *rowOffsetData() const { return rowOffsets; }
+    const int *rowRankData() const { return rowRanks; }
+    int getNumRows() const { return rowStart[n]; }
+    Types::Score getScore(int idx) const { return scores[idx]; }
+    const Types::Score *getScores(int idx) const { return &scores[idx]; }
+    const Types::Block *getMask(int idx) const { return &masks[(size_t)idx * numBlocks]; }
+    bool hasElement(int idx, int k) const {
+      if (!withMasks) {
+        for (int p = parentOffsets[idx]; p < parentOffsets[idx + 1]; p++) {
+          if (parentList[p] == k) {
+            return true;
+          }
+        }
+        return false;
+      }
+      return (getMask(idx)[k / Types::BLOCK_BITS] >> (k % Types::BLOCK_BITS)) & 1;
+    }
+    bool subsetOf(int idx, const Types::Bitset &set) const {
+      if (!withMasks) {
+        for (int p = parentOffsets[idx]; p < parentOffsets[idx + 1]; p++) {
+          if (!set[parentList[p]]) {
+            return false;
+          }
+        }
+        return true;
+      }
+      return set.contains(getMask(idx));
+    }
+    // True iff every parent of set idx is extra or sits at a position below limit.
+    bool precedes(int idx, const int *positions, int limit, int extra) const {
+      for (int p = parentOffsets[idx]; p < parentOffsets[idx + 1]; p++) {
+        int parent = parentList[p];
+        if (positions[parent] >= limit && parent != extra) {
+          return false;
+        }
+      }
+      return true;
+    }
+    // Offset (from begin) of the first of count consecutive sets that is a subset of set, or -1.
+    int firstSubset(int begin, int count, const Types::Bitset &set) const {
+      if (!withMasks) {
+        for (int i = 0; i < count; i++) {
+          if (subsetOf(begin + i, set)) {
+            return i;
+          }
+        }
+        return -1;
+      }
+      return SubsetKernel::firstSubset(getMask(begin), numBlocks, count, set.blocks());
+    }
+    // Position k of the first set begin + ids[k] that is a subset of set, or -1.
+    int firstSubsetOf(int begin, const int *ids, int count, const Types::Bitset &set) const {
+      if (!withMasks) {
+        for (int k = 0; k < count; k++) {
+          if (subsetOf(begin + ids[k], set)) {
+            return k;
+          }
+        }
+        return -1;
+      }
+      return SubsetKernel::firstSubsetIndexed(getMask(begin), numBlocks, ids, count, set.blocks());
+    }
+    ParentList getParents(int idx) const {
+      return ParentList(parentList + parentOffsets[idx], parentList + parentOffsets[idx + 1]);
+    }
+    // Ranks of the sets of var that contain parent, in score order.
+    ParentList withParent(int var, int parent) const {
+      int row;
+      if (denseParentLists()) {
+        row = rowStart[var] + parent;
+      } else {
+        const int *first = rowKeys + rowStart[var];
+        const int *last = rowKeys + rowStart[var + 1];
+        const int *found = std::lower_bound(first, last, parent);
+        if (found == last || *found != parent) {
+          return ParentList(rowRanks, rowRanks);
+        }
+        row = found - rowKeys;
+      }
+      return ParentList(rowRanks + rowOffsets[row], rowRanks + rowOffsets[row + 1]);
+    }
+  private:
+    void refresh();
+    int n;
+    int numBlocks;
+    bool withMasks;
+    int size;
+    const Types::Score *scores;
+    const Types::Block *masks;
+    const int *parentOffsets;
+    const int *parentList;
+    const int *rowStart;
+    const int *rowKeys;
+    const int *rowOffsets;
+    const int *rowRanks;
+    std::vector<Types::Score> ownScores;
+    std::vector<Types::Block> ownMasks;
+    std::vector<int> ownParentOffsets;
+    std::vector<int> ownParentList;
+    std::vector<int> ownRowStart;
+    std::vector<int> ownRowKeys;
+    std::vector<int> ownRowOffsets;
+    std::vector<int> ownRowRanks;
+};
+
+#endif /* PARENTSETSTORE_H */
@@ -0,0 +1,29 @@
+#include "pivotqueue.h"
+#include "debug.h"
+
+PivotQueue::PivotQueue(int n) : ring(n), queued(n, 0), head(0), count(0) { }
+
+void PivotQueue::clear() {
+  while (!empty()) {
+    pop();
+  }
+}
+
+void PivotQueue::push(int var) {
+  if (queued[var]) {
+    return;
+  }
+  int n = ring.size();
+  int tail = head + count;
+  ring[tail >= n ? tail - n : tail] = var;
+  queued[var] = 1;
+  count++;
+}
+
+int PivotQueue::pop() {
+  int var = ring[head];
+  queued[var] = 0;
+  head = head + 1 == (int)ring.size() ? 0 : head + 1;
+  count--;
+  return var;
+}
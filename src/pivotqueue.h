@@ -0,0 +1,26 @@
+#ifndef PIVOTQUEUE_H
+#define PIVOTQUEUE_H
+
+#include <vector>
+
+// First in, first out queue of the variables hillClimb still has to try as
+// pivots, each queued at most once. A variable that is not queued has its
+// don't-look bit set.
+class PivotQueue {
+  public:
+    PivotQueue(int n);
+    void clear();
+    bool empty() const { return count == 0; }
+    bool contains(int var) const { return queued[var]; }
+    // No-op for a queued variable.
+    void push(int var);
+    int pop();
+  private:
+    // Ring buffer of n slots starting at head.
+    std::vector<int> ring;
+    std::vector<char> queued;
+    int head;
+    int count;
+};
+
+#endif /* PIVOTQUEUE_H */
@@ -1,11 +1,43 @@
 #include "population.h"
 #include "assert.h"
-#include <map>
 #include "debug.h"
 #include <numeric>
 #include <algorithm>
-Population::Population(LocalSearch &localSearch) :
-  localSearch(localSearch) { }
+Population::Population(LocalSearch &localSearch, WorkerPool &pool, uint64_t seed, int cacheCapacity) :
+  localSearch(localSearch), pool(pool),
+  workspaces(pool.getNumThreads(), ScoringWorkspace(localSearch.getInstance().getN())),
+  crossoverWorkspace(localSearch.getInstance().getN()), rng(seed),
+  cache(cacheCapacity) { }
+
+void Population::setDeadline(const Deadline &deadline) {
+  this->deadline = deadline;
+}
+
+// Climbs starts[i] into child, unless an earlier batch already did.
+void Population::climb(int i, SearchResult &child, int worker, Rng &rng) {
+  if (cache.find(starts[i], child)) {
+    return;
+  }
+  Deadline climbDeadline(deadline);
+  child = localSearch.hillClimb(starts[i], workspaces[worker], rng, climbDeadline);
+}
+
+// The cache only changes between batches, so whether a child hits it does not
+// depend on scheduling. Climbs cut short by the deadline are not cached, and
+// skipped children, left with an empty ordering, are dropped.
+void Population::finishBatch(int first, std::vector<SearchResult> &offspring) {
+  if (!deadline.reached()) {
+    for (int i = first; i < (int)offspring.size(); i++) {
+      if (offspring[i].getOrderingRef().getSize() != 0) {
+        cache.insert(starts[i - first], offspring[i]);
+        cache.insert(offspring[i].getOrderingRef(), offspring[i]);
+      }
+    }
+  }
+  offspring.erase(std::remove_if(offspring.begin() + first, offspring.end(), [](SearchResult &sr) {
+    return sr.getOrderingRef().getSize() == 0;
+  }), offspring.end());
+}
 
 int Population::getSize() const {
   return specimens.size();
@@ -30,71 +62,118 @@ std::ostream& operator<<(std::ostream &os, const Population& v) {
   return os;
 }
 
+// Children are built by crossover, then climbed on the worker pool. Child i
+// draws from its own streams of the batch seed and lands in slot i of
+// offspring, so the result does not depend on the number of threads or on
+// scheduling.
 void Population::addCrossovers(int n, CrossoverType crossoverType, std::vector<SearchResult> &offspring) {
-  for (int i = 0; i < n; i++) {
-    int numOrderings = getSize();
-    int a = rand()%numOrderings;
-    int b = rand()%(numOrderings - 1);
+  int first = offspring.size();
+  offspring.resize(first + n);
+  uint64_t seed = rng.next();
+  crossover(n, crossoverType, seed, starts);
+  pool.run(n, [&](int i, int worker) {
+    if (deadline.reached()) {
+      return;
+    }
+    Rng childRng(seed, n + i);
+    climb(i, offspring[first + i], worker, childRng);
+    DBG("Crossed: " << starts[i]);
+    DBG("Crossed Result: " << offspring[first + i]);
+  });
+  finishBatch(first, offspring);
+}
+
+// Each child costs O(n): it is cheaper to build the whole batch here than to
+// hand the work to the pool.
+void Population::crossover(int k, CrossoverType crossoverType, uint64_t seed, std::vector<Ordering> &children) {
+  int numOrderings = getSize();
+  children.resize(k);
+  for (int i = 0; i < k; i++) {
+    Rng childRng(seed, i);
+    int a = childRng.uniform(numOrderings);
+    int b = childRng.uniform(numOrderings - 1);
     if (b >= a) {
       b += 1;
     }
-    const Ordering &o1 = specimens[a].getOrdering();
-    const Ordering &o2 = specimens[b].getOrdering();
+    const Ordering &o1 = specimens[a].getOrderingRef();
+    const Ordering &o2 = specimens[b].getOrderingRef();
     DBG("Crossing: (" << specimens[a] << "), (" << specimens[b] << ")");
-    Ordering crossed(o1.getSize());
     if (crossoverType == CrossoverType::OB) {
-      crossed = crossoverOB(o1, o2);
+      crossoverOB(o1, o2, childRng, crossoverWorkspace, children[i]);
     } else if (crossoverType == CrossoverType::CX) {
-      crossed = crossoverCX(o1, o2);
+      crossoverCX(o1, o2, childRng, crossoverWorkspace, children[i]);
     } else {
-      crossed = crossoverRK(o1, o2);
+      crossoverRK(o1, o2, childRng, crossoverWorkspace, children[i]);
     }
-    
-    SearchResult sr = localSearch.hillClimb(crossed);
-    DBG("Crossed: " << crossed);
-    DBG("Crossed Result: " << sr);
-    offspring.push_back(sr);
   }
 }
 
-Ordering Population::crossoverOB(const Ordering &o1, const Ordering &o2) {
+void Population::generate(int n, int greediness, std::vector<SearchResult> &offspring) {
+  const Instance &instance = localSearch.getInstance();
+  int first = offspring.size();
+  offspring.resize(first + n);
+  starts.resize(n);
+  uint64_t seed = rng.next();
+  pool.run(n, [&](int i, int worker) {
+    if (i > 0 && deadline.reached()) {
+      return;
+    }
+    Rng childRng(seed, i);
+    starts[i] = greediness == -1 ? Ordering::randomOrdering(instance, childRng) :
+      Ordering::greedyOrdering(instance, greediness, childRng);
+    climb(i, offspring[first + i], worker, childRng);
+  });
+  finishBatch(first, offspring);
+}
+
+void Population::crossoverOB(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed) {
   assert(o1.getSize() == o2.getSize());
   int n = o1.getSize();
-  Ordering crossed = Ordering(n);
-  Types::Bitset seen(n, 0);
-  Types::Bitset seenO1(n, 0);
+  if (crossed.getSize() != n) {
+    crossed = Ordering(n);
+  }
+  std::vector<char> &kept = cw.kept;
+  std::vector<char> &taken = cw.taken;
+  std::fill(taken.begin(), taken.begin() + n, 0);
   for (int i = 0; i < n; i++) {
-    int roll = rand()%2;
-    if (roll) {
-      seen[i] = 1;
-      seenO1[o1.get(i)] = 1;
+    kept[i] = rng.uniform(2);
+    if (kept[i]) {
+      taken[o1.get(i)] = 1;
       crossed.set(i, o1.get(i));
     }
   }
   int o2Idx = 0;
   for (int i = 0; i < n; i++) {
-    if (!(seen[i])) {
-      while(seenO1[o2.get(o2Idx)] != 0) {
+    if (!kept[i]) {
+      while (taken[o2.get(o2Idx)]) {
         o2Idx++;
       }
       crossed.set(i, o2.get(o2Idx));
-      seenO1[o2.get(o2Idx)] = 1;
+      taken[o2.get(o2Idx)] = 1;
     }
   }
-  return crossed;
 }
 
 void Population::mutate(int NUM_MUTATIONS, int MUTATION_POWER, std::vector<SearchResult> &offspring) {
   assert(specimens.size() > 0);
-  for (int i = 0; i < NUM_MUTATIONS; i++) {
-    Ordering mutated = specimens[rand()%getSize()].getOrderingRef();
+  int first = offspring.size();
+  offspring.resize(first + NUM_MUTATIONS);
+  starts.resize(NUM_MUTATIONS);
+  uint64_t seed = rng.next();
+  pool.run(NUM_MUTATIONS, [&](int i, int worker) {
+    if (deadline.reached()) {
+      return;
+    }
+    Rng childRng(seed, i);
+    Ordering &mutated = starts[i];
+    mutated = specimens[childRng.uniform(getSize())].getOrderingRef();
     DBG(mutated);
-    mutated.perturb(MUTATION_POWER);
+    mutated.perturb(MUTATION_POWER, childRng);
     DBG(mutated);
-    SearchResult climbed = localSearch.hillClimb(mutated);
-    DBG("Mutated: " << climbed);
-    offspring.push_back(climbed);
-  }
+    climb(i, offspring[first + i], worker, childRng);
+    DBG("Mutated: " << offspring[first + i]);
+  });
+  finishBatch(first, offspring);
 }
 
 void Population::filterBest(int n) {
@@ -124,58 +203,36 @@ Types::Score Population::getAverageFitness() {
   return sum/n;
 }
 
-Ordering Population::crossoverCX(const Ordering &o1, const Ordering &o2) {
+// The positions split into cycles, along each of which o1 and o2 hold the
+// same variables; every cycle takes its variables from o1 or o2 on a coin
+// toss. Each position is visited once.
+void Population::crossoverCX(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed) {
+  assert(o1.getSize() == o2.getSize());
   int n = o1.getSize();
-  std::vector<int> o1Inv(n);
-  std::vector<int> o2Inv(n);
-  for (int i = 0; i < n; i++) {
-    o1Inv[o1.get(i)] = i;
-    o2Inv[o2.get(i)] = i;
+  if (crossed.getSize() != n) {
+    crossed = Ordering(n);
   }
-  Ordering crossed(n);
-  std::vector<int> notCrossed;
-  for (int i = 0; i < n; i++) {
-    if (o1.get(i) == o2.get(i)) {
-      crossed.set(i, o1.get(i));
-    } else {
-      notCrossed.push_back(i);
+  std::vector<char> &crossedAt = cw.taken;
+  std::fill(crossedAt.begin(), crossedAt.begin() + n, 0);
+  for (int start = 0; start < n; start++) {
+    if (crossedAt[start]) {
+      continue;
     }
-  }
-  while (!notCrossed.empty()) {
-    int numNotCrossed = notCrossed.size();
-    int idx = notCrossed[rand()%numNotCrossed];
-    int coinToss = rand()%2;
-    Ordering p1(n);
-    Ordering p2(n);
-    std::vector<int> p1Inv, p2Inv;
-    if (coinToss) {
-      p1 = o1;
-      p1Inv = o1Inv;
-      p2 = o2;
-      p2Inv = o2Inv;
-    } else {
-      p1 = o2;
-      p1Inv = o2Inv;
-      p2 = o1;
-      p2Inv = o1Inv;
+    if (o1.get(start) == o2.get(start)) {
+      crossed.set(start, o1.get(start));
+      crossedAt[start] = 1;
+      continue;
     }
-
-    int initIdx = idx;
-    //DBG("CYCLED " << crossed << "numrossed" << numNotCrossed);
-    do  {
-      //DBG(idx << " p1: " << p1.get(idx) << " p2: " << p2.get(idx) << " crossed: " << crossed);
-      crossed.set(idx, p1.get(idx));
-      notCrossed.erase(std::remove(notCrossed.begin(), notCrossed.end(), idx), notCrossed.end());
-      int next = p1Inv[p2.get(idx)];
-      idx = next;
-
-    } while (idx != initIdx);
+    const Ordering &p = rng.uniform(2) ? o1 : o2;
+    int idx = start;
+    do {
+      crossed.set(idx, p.get(idx));
+      crossedAt[idx] = 1;
+      idx = o1.getPosition(o2.get(idx));
+    } while (idx != start);
   }
-  return crossed;
 }
 
-
-
 void Population::diversify(int numKeep, const Instance &instance) {
   std::vector<SearchResult> diversified;
   int size = getSize();
@@ -184,9 +241,7 @@ void Population::diversify(int numKeep, const Instance &instance) {
   for (int i = 0; i < numKeep; i++) {
     diversified.push_back(specimens[i]);
   }
-  for (int i = 0; i < size - numKeep; i++) {
-    diversified.push_back(localSearch.hillClimb(Ordering::greedyOrdering(instance)));
-  }
+  generate(size - numKeep, 10, diversified);
   specimens = diversified;
 }
 
@@ -194,31 +249,36 @@ void Population::append(const std::vector<SearchResult> &offspring) {
   specimens.insert(specimens.end(), offspring.begin(), offspring.end());
 }
 
-Ordering Population::crossoverRK(const Ordering &o1, const Ordering &o2) {
-  std::map<int, std::vector<int>> rankMap;
-  DBG("test");  
+// Variables sorted by the sum of their positions in o1 and o2, ties in
+// random order. The sums are below 2n, so a counting sort does.
+void Population::crossoverRK(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed) {
+  assert(o1.getSize() == o2.getSize());
   int n = o1.getSize();
-  std::vector<int> o1Inv(n);
-  std::vector<int> o2Inv(n);
-  for (int i = 0; i < n; i++) {
-    o1Inv[o1.get(i)] = i;
-    o2Inv[o2.get(i)] = i;
+  if (crossed.getSize() != n) {
+    crossed = Ordering(n);
   }
-  assert(o1.getSize() == o2.getSize());
-  for (int i = 0 ; i < o1.getSize(); i++) {
-    rankMap[o1Inv[i]+o2Inv[i]].push_back(i);
-  }
-  Ordering crossed(n);
-  int cur = 0;
-  for (auto iterator : rankMap) {
-    std::vector<int> &currentBucket = iterator.second;
-    if (currentBucket.size() > 1) {
-      std::random_shuffle(currentBucket.begin(), currentBucket.end());
-    }
-    for (int i = 0; i < currentBucket.size(); i++) {
-      crossed.set(cur, (currentBucket)[i]);
-      cur++;
+  std::vector<int> &bucketStart = cw.bucketStart;
+  std::vector<int> &order = cw.order;
+  std::fill(bucketStart.begin(), bucketStart.begin() + 2 * n, 0);
+  for (int var = 0; var < n; var++) {
+    bucketStart[o1.getPosition(var) + o2.getPosition(var) + 1]++;
+  }
+  for (int rank = 1; rank < 2 * n; rank++) {
+    bucketStart[rank] += bucketStart[rank - 1];
+  }
+  // Fill the buckets in variable order, advancing each start to its end.
+  for (int var = 0; var < n; var++) {
+    order[bucketStart[o1.getPosition(var) + o2.getPosition(var)]++] = var;
+  }
+  int begin = 0;
+  for (int rank = 0; rank < 2 * n - 1; rank++) {
+    int end = bucketStart[rank];
+    if (end - begin > 1) {
+      rng.shuffle(order.begin() + begin, order.begin() + end);
     }
+    begin = end;
   }
-  return crossed;
-}
\ No newline at end of file
+  for (int i = 0; i < n; i++) {
+    crossed.set(i, order[i]);
+  }
+}
@@ -5,6 +5,12 @@
 #include "ordering.h"
 #include "instance.h"
 #include "searchresult.h"
+#include "scoringworkspace.h"
+#include "crossoverworkspace.h"
+#include "workerpool.h"
+#include "deadline.h"
+#include "climbcache.h"
+#include "rng.h"
 #include "types.h"
 
 class LocalSearch;
@@ -13,23 +19,49 @@ enum class CrossoverType;
 
 class Population {
   public:
-    Population(LocalSearch &localSearch);
+    // Offspring are climbed on pool; seed starts the random streams. The
+    // last cacheCapacity or so climbs are remembered, see ClimbCache.
+    Population(LocalSearch &localSearch, WorkerPool &pool, uint64_t seed, int cacheCapacity = ClimbCache::DEFAULT_CAPACITY);
+    // Once deadline is reached, children that have not started are dropped
+    // and running climbs stop early. generate always climbs its first child.
+    void setDeadline(const Deadline &deadline);
     void addSpecimen(const SearchResult &o);
     int getSize() const;
     SearchResult getSpecimen(int i) const;
     friend std::ostream& operator<<(std::ostream &os, const Population& sr);
     void addCrossovers(int n, CrossoverType crossoverType, std::vector<SearchResult> &offspring);
-    Ordering crossoverOB(const Ordering &o1, const Ordering &o2);
-    Ordering crossoverCX(const Ordering &o1, const Ordering &o2);
+    // Builds k children into children, each from two distinct specimens
+    // drawn at random. Child i draws from stream i of seed.
+    void crossover(int k, CrossoverType crossoverType, uint64_t seed, std::vector<Ordering> &children);
+    // Climbs n random (greediness -1) or greedy orderings into offspring.
+    void generate(int n, int greediness, std::vector<SearchResult> &offspring);
+    // The crossover operators write the child into crossed, in O(n) time
+    // and without allocating once crossed has size n.
+    static void crossoverOB(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed);
+    static void crossoverCX(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed);
+    static void crossoverRK(const Ordering &o1, const Ordering &o2, Rng &rng, CrossoverWorkspace &cw, Ordering &crossed);
     void mutate(int NUM_MUTATIONS, int MUTATION_POWER, std::vector<SearchResult> &offspring);
     void filterBest(int n);
     Types::Score getAverageFitness();
     void diversify(int numKeep, const Instance &instance);
-    Ordering crossoverRK(const Ordering &o1, const Ordering &o2);
     void append(const std::vector<SearchResult> &offspring);
+    const ClimbCache &getCache() const { return cache; }
   private:
+    void climb(int i, SearchResult &child, int worker, Rng &rng);
+    void finishBatch(int first, std::vector<SearchResult> &offspring);
     std::vector<SearchResult> specimens;
     LocalSearch &localSearch;
+    WorkerPool &pool;
+    Deadline deadline;
+    // One per pool thread.
+    std::vector<ScoringWorkspace> workspaces;
+    // Used by crossover, on the calling thread.
+    CrossoverWorkspace crossoverWorkspace;
+    // Draws the seed of each batch of offspring.
+    Rng rng;
+    // Starting ordering of each child of the current batch.
+    std::vector<Ordering> starts;
+    ClimbCache cache;
 };
 
 #endif /* POPULATION_H */
\ No newline at end of file
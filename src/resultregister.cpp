@@ -1,45 +1,91 @@
 #include "resultregister.h"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <numeric>
 #include <sstream>
 #include "debug.h"
 #include <climits>
 
-ResultRegister::ResultRegister() : origin(0), checkOrigin(0), bestScore(LLONG_MAX), scores(0), bestScores(0), bestOrderings(0) {
+ResultRegister::ResultRegister() : origin(0), checkOrigin(0), bestScore(LLONG_MAX), pending(NULL), stopping(false) {
   set();
+  writerThread = std::thread(&ResultRegister::writer, this);
 }
 
-void ResultRegister::record(Types::Score score, const Ordering &o) {
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  long int curMill = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-  if (score < bestScore) {
-    bestScore = score;
-    bestScores.push_back(std::make_pair(curMill - origin, score));
+ResultRegister::~ResultRegister() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writerThread.join();
+}
+
+bool ResultRegister::record(Types::Score score, const Ordering &o) {
+  Types::Score best = bestScore.load(std::memory_order_relaxed);
+  do {
+    if (score >= best) {
+      return false;
+    }
+  } while (!bestScore.compare_exchange_weak(best, score, std::memory_order_relaxed));
+  Improvement *improvement = new Improvement();
+  improvement->time = (Deadline::nowNs() - origin.load(std::memory_order_relaxed)) / 1000000;
+  improvement->score = score;
+  improvement->ordering.resize(o.getSize());
+  for (int i = 0; i < o.getSize(); i++) {
+    improvement->ordering[i] = o.get(i);
+  }
+  improvement->next = pending.load(std::memory_order_relaxed);
+  while (!pending.compare_exchange_weak(improvement->next, improvement, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+  wake.notify_one();
+  return true;
+}
+
+// Formats the pushed improvements off the search threads. A missed wake up
+// only delays the formatting until the next timeout.
+void ResultRegister::writer() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    wake.wait_for(lock, std::chrono::milliseconds(100));
+    drain();
+  }
+  drain();
+}
+
+// Caller holds mutex.
+void ResultRegister::drain() {
+  Improvement *improvement = pending.exchange(NULL, std::memory_order_acquire);
+  // The stack is newest first, and every improvement beats the ones before it.
+  std::vector<Improvement *> batch;
+  for (; improvement; improvement = improvement->next) {
+    batch.push_back(improvement);
+  }
+  for (int i = (int)batch.size() - 1; i >= 0; i--) {
     std::stringstream ss;
-    ss << o;
+    for (int var : batch[i]->ordering) {
+      ss << var << ' ';
+    }
+    bestScores.push_back(std::make_pair(batch[i]->time, batch[i]->score));
     bestOrderings.push_back(ss.str());
+    delete batch[i];
   }
 }
 
 float ResultRegister::check() {
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  long int curMill = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-  return ((double)curMill - (double)checkOrigin)/(float)1000;
+  return (Deadline::nowNs() - checkOrigin.load(std::memory_order_relaxed)) / 1e9;
+}
+
+Deadline ResultRegister::deadline(float timeLimit) const {
+  return Deadline(checkOrigin.load(std::memory_order_relaxed) + (int64_t)(timeLimit * 1e9));
 }
 
 void ResultRegister::set() {
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  long int curMill = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-  origin = curMill;
+  origin = Deadline::nowNs();
 }
 
 void ResultRegister::setOrigin() {
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  long int curMill = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-  checkOrigin = curMill;
+  checkOrigin = Deadline::nowNs();
 }
 
 void ResultRegister::dump(const std::string &outFile) {
@@ -64,19 +110,20 @@ void ResultRegister::dump(const std::string &outFile, const std::string &instanc
 
 
 void ResultRegister::write(std::ofstream &os) {
+  std::lock_guard<std::mutex> lock(mutex);
+  drain();
+  // Threads can push their improvements out of order; the scores give the
+  // order in which they were won.
+  int nBest = bestScores.size();
+  std::vector<int> order(nBest);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return bestScores[a].second > bestScores[b].second;
+  });
   os << "BEST" << std::endl;
   os << "Time (ms)\tScore, followed by ordering next line" << std::endl;
-  int nBest = bestScores.size();
-  for (int i = 0; i < nBest; i++) {
+  for (int i : order) {
     os << bestScores[i].first << "\t" << bestScores[i].second << std::endl;
     os << bestOrderings[i] << std::endl;
   }
 }
-
-Types::Score ResultRegister::getBest() {
-  if (scores.size() < 1) {
-    return LLONG_MAX;
-  }
-  return bestScore;
-}
-
@@ -1,33 +1,64 @@
 #ifndef RESULTREGISTER_H
-#define RESULTREGISTER_H 
+#define RESULTREGISTER_H
 
-#include <sys/time.h>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <string>
 #include "searchresult.h"
 #include "ordering.h"
+#include "deadline.h"
 #include "types.h"
 
+// Best score over time, shared by every search thread. record is lock-free:
+// improvements win a compare-and-swap on the best score and are pushed, as a
+// plain copy of the ordering, onto a lock-free stack that a background writer
+// thread drains and formats. Scores that are not improvements only cost one
+// atomic load.
 class ResultRegister {
   public:
     ResultRegister();
-    void record(Types::Score score, const Ordering &o);
+    ~ResultRegister();
+    // True iff score improved on the best score so far.
+    bool record(Types::Score score, const Ordering &o);
     void set();
     void setOrigin();
     void dump(const std::string &outFile);
-    Types::Score getBest();
+    Types::Score getBest() const { return bestScore.load(std::memory_order_relaxed); }
+    // Seconds since setOrigin, on the monotonic clock.
     float check();
+    // Expires timeLimit seconds after setOrigin, like check() > timeLimit.
+    Deadline deadline(float timeLimit) const;
     void write(std::ofstream &os);
     void dump(const std::string &outFile, const std::string &instanceTitle);
     void dump(const std::string &outFile, const std::string &instanceTitle, int argc, char* argv[], const SearchResult &sr);
   private:
-    long int origin;
-    long int checkOrigin;
-    Types::Score bestScore;
-    std::vector<std::pair<long int, Types::Score>> scores;
+    ResultRegister(const ResultRegister &);
+    ResultRegister &operator=(const ResultRegister &);
+    struct Improvement {
+      long int time;
+      Types::Score score;
+      std::vector<int> ordering;
+      Improvement *next;
+    };
+    void writer();
+    void drain();
+    // Monotonic nanoseconds of set and setOrigin.
+    std::atomic<int64_t> origin;
+    std::atomic<int64_t> checkOrigin;
+    std::atomic<Types::Score> bestScore;
+    std::atomic<Improvement *> pending;
+    // Owned by the writer; guarded by mutex.
     std::vector<std::pair<long int, Types::Score>> bestScores;
     std::vector<std::string> bestOrderings;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread writerThread;
 };
 
 #endif /* RESULTREGISTER_H */
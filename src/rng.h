@@ -0,0 +1,69 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <utility>
+
+// xoshiro256** generator. It is small and cheap to seed, so every search
+// thread, or every task of a parallel batch, draws from its own stream
+// instead of sharing the state behind rand().
+class Rng {
+  public:
+    Rng(uint64_t seed = 0) {
+      init(seed);
+    }
+    // Independent stream number stream of seed.
+    Rng(uint64_t seed, uint64_t stream) {
+      uint64_t x = stream;
+      init(seed ^ splitmix(x));
+    }
+    uint64_t next() {
+      uint64_t result = rotl(s[1] * 5, 7) * 9;
+      uint64_t t = s[1] << 17;
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = rotl(s[3], 45);
+      return result;
+    }
+    // Uniform in [0, n), for 0 < n < 2^32.
+    int uniform(int n) {
+      return (int)(((next() >> 32) * (uint64_t)n) >> 32);
+    }
+    // Uniform in [0, 1).
+    double real() {
+      return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    // splitmix64 output function: a well mixed 64-bit hash of x.
+    static uint64_t hash(uint64_t x) {
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+    template <class It>
+    void shuffle(It first, It last) {
+      for (int i = (int)(last - first) - 1; i > 0; i--) {
+        std::swap(first[i], first[uniform(i + 1)]);
+      }
+    }
+  private:
+    static uint64_t rotl(uint64_t x, int k) {
+      return (x << k) | (x >> (64 - k));
+    }
+    static uint64_t splitmix(uint64_t &x) {
+      uint64_t z = hash(x);
+      x += 0x9e3779b97f4a7c15ULL;
+      return z;
+    }
+    void init(uint64_t seed) {
+      for (int i = 0; i < 4; i++) {
+        s[i] = splitmix(seed);
+      }
+    }
+    uint64_t s[4];
+};
+
+#endif /* RNG_H */
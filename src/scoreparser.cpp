@@ -0,0 +1,236 @@
+#include "scoreparser.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <sys/time.h>
+#include "debug.h"
+
+namespace {
+
+const int SCORE_SCALE = -1000000;
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c) {
+  return (unsigned)(c - '0') < 10;
+}
+
+inline void skipSpace(const char *&p, const char *end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+}
+
+int parseInt(const char *&p, const char *end) {
+  skipSpace(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    throw "Malformed instance file";
+  }
+  int value = 0;
+  while (p < end && isDigit(*p)) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  return negative ? -value : value;
+}
+
+// Skips whitespace and the token after it.
+inline void skipToken(const char *&p, const char *end) {
+  skipSpace(p, end);
+  if (p == end) {
+    throw "Malformed instance file";
+  }
+  while (p < end && !isSpace(*p)) {
+    p++;
+  }
+}
+
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+}
+
+ScoreParser::ScoreParser(const std::string &fileName) : file(fileName), n(0), numSets(0), listSize(0), seconds(0) { }
+
+// Clinger's fast path: with at most 19 digits the mantissa is an exact
+// integer; if it is below 2^53 and the decimal exponent lies in [-22, 22],
+// mantissa and power of ten are exact doubles and a single IEEE multiply or
+// divide rounds correctly. Anything else goes through strtod.
+double ScoreParser::parseDouble(const char *&p, const char *end) {
+  static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  skipSpace(p, end);
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  const char *digits = p;
+  for (; p < end && isDigit(*p); p++) {
+    mantissa = mantissa * 10 + (*p - '0');
+  }
+  int numDigits = p - digits;
+  int exponent = 0;
+  if (p < end && *p == '.') {
+    const char *fraction = ++p;
+    for (; p < end && isDigit(*p); p++) {
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+    exponent = fraction - p;
+    numDigits += p - fraction;
+  }
+  if (numDigits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+    const char *e = p + 1;
+    bool negativeExp = false;
+    if (e < end && (*e == '-' || *e == '+')) {
+      negativeExp = *e == '-';
+      e++;
+    }
+    if (e < end && isDigit(*e)) {
+      int exp = 0;
+      for (; e < end && isDigit(*e); e++) {
+        exp = std::min(exp * 10 + (*e - '0'), 100000);
+      }
+      exponent += negativeExp ? -exp : exp;
+      p = e;
+    }
+  }
+  if (numDigits > 0 && numDigits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+    double value = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+    return negative ? -value : value;
+  }
+  // The mapping is not NUL terminated, so strtod gets a copy of the token.
+  p = start;
+  while (p < end && !isSpace(*p)) {
+    p++;
+  }
+  std::string token(start, p);
+  char *tokenEnd;
+  double value = std::strtod(token.c_str(), &tokenEnd);
+  if (tokenEnd == token.c_str()) {
+    throw "Malformed instance file";
+  }
+  p = start + (tokenEnd - token.c_str());
+  return value;
+}
+
+// Block boundaries are found by skimming the tokens: a parent set is a score,
+// a parent count k and k parents, however they are spread over lines. Only
+// the counts are parsed; the rest is left to the workers.
+void ScoreParser::split() {
+  const char *p = file.data();
+  const char *end = p + file.size();
+  n = parseInt(p, end);
+  numSets = 0;
+  listSize = 0;
+  ranges.clear();
+  ranges.reserve(n);
+  for (int i = 0; i < n; i++) {
+    Range range;
+    skipSpace(p, end);
+    range.begin = p;
+    range.firstSet = numSets;
+    range.firstParent = listSize;
+    parseInt(p, end);
+    int numParents = parseInt(p, end);
+    for (int j = 0; j < numParents; j++) {
+      skipToken(p, end);
+      int parentSize = parseInt(p, end);
+      for (int k = 0; k < parentSize; k++) {
+        skipToken(p, end);
+      }
+      listSize += parentSize;
+    }
+    numSets += numParents;
+    range.end = p;
+    ranges.push_back(range);
+  }
+}
+
+// A block only writes the sets [firstSet, firstSet + count) and the offsets
+// past them, so blocks can be written concurrently.
+void ScoreParser::parseBlock(const Range &range, Block &block, Scratch &scratch, ParentSetStore &store) const {
+  const char *p = range.begin;
+  const char *end = range.end;
+  block.varId = parseInt(p, end);
+  int numParents = parseInt(p, end);
+  block.first = range.firstSet;
+  block.count = numParents;
+  scratch.scores.resize(numParents);
+  scratch.offsets.resize(numParents + 1);
+  scratch.parents.clear();
+  scratch.offsets[0] = 0;
+  for (int j = 0; j < numParents; j++) {
+    scratch.scores[j] = (Types::Score)(parseDouble(p, end) * SCORE_SCALE);
+    int parentSize = parseInt(p, end);
+    for (int k = 0; k < parentSize; k++) {
+      scratch.parents.push_back(parseInt(p, end));
+    }
+    scratch.offsets[j + 1] = scratch.parents.size();
+  }
+  // Parent sets are stored in score order, so the rank of a set is its id.
+  std::vector<int> &order = scratch.order;
+  order.resize(numParents);
+  std::iota(order.begin(), order.end(), 0);
+  const std::vector<Types::Score> &parsed = scratch.scores;
+  std::sort(order.begin(), order.end(), [&parsed](int a, int b) {
+    return parsed[a] < parsed[b];
+  });
+  Types::Score *scores = store.mutableScores() + range.firstSet;
+  int *offsets = store.mutableOffsets() + range.firstSet;
+  int *list = store.mutableList();
+  int listEnd = range.firstParent;
+  for (int j = 0; j < numParents; j++) {
+    int o = order[j];
+    scores[j] = parsed[o];
+    listEnd = std::copy(scratch.parents.data() + scratch.offsets[o], scratch.parents.data() + scratch.offsets[o + 1],
+        list + listEnd) - list;
+    offsets[j + 1] = listEnd;
+  }
+}
+
+void ScoreParser::parse(WorkerPool &pool, ParentSetStore &store) {
+  double start = now();
+  split();
+  store.allocate(n, numSets, listSize);
+  blocks.clear();
+  blocks.resize(ranges.size());
+  std::vector<Scratch> scratch(pool.getNumThreads());
+  // Blocks vary a lot in size; the pool hands them out one at a time.
+  pool.run(ranges.size(), [&](int b, int worker) {
+    parseBlock(ranges[b], blocks[b], scratch[worker], store);
+  });
+  seconds = now() - start;
+  DBG("Parsed " << file.size() << " bytes in " << seconds << "s on " << pool.getNumThreads() << " threads");
+}
+
+int ScoreParser::getN() const {
+  return n;
+}
+
+std::vector<ScoreParser::Block> &ScoreParser::getBlocks() {
+  return blocks;
+}
+
+size_t ScoreParser::getBytes() const {
+  return file.size();
+}
+
+double ScoreParser::getSeconds() const {
+  return seconds;
+}
@@ -0,0 +1,61 @@
+#ifndef SCOREPARSER_H
+#define SCOREPARSER_H
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "mappedfile.h"
+#include "parentsetstore.h"
+#include "workerpool.h"
+
+// Parallel parser for text score files. The file is mapped, split at the
+// variable blocks ("<var> <numParents>" followed by, per parent set, its
+// score, its number of parents and the parents; line breaks do not matter)
+// by a token skim that also counts the sets and parents of each block, and
+// the blocks are parsed on a WorkerPool. Each block is written, sorted by
+// score, straight into its own slice of a ParentSetStore sized from the
+// counts.
+class ScoreParser {
+  public:
+    struct Block {
+      int varId;
+      // The sets of the block are [first, first + count) in the store.
+      int first;
+      int count;
+    };
+    ScoreParser(const std::string &fileName);
+    // Leaves store allocated and filled but not finished (see ParentSetStore::allocate).
+    void parse(WorkerPool &pool, ParentSetStore &store);
+    int getN() const;
+    std::vector<Block> &getBlocks();
+    size_t getBytes() const;
+    double getSeconds() const;
+    // Parses a double at p (leading whitespace skipped), correctly rounded
+    // like strtod, and advances p past it.
+    static double parseDouble(const char *&p, const char *end);
+  private:
+    struct Range {
+      const char *begin;
+      const char *end;
+      int firstSet;
+      int firstParent;
+    };
+    // Per-thread buffers holding a block in file order, before the sort.
+    struct Scratch {
+      std::vector<Types::Score> scores;
+      std::vector<int> offsets;
+      std::vector<int> parents;
+      std::vector<int> order;
+    };
+    void split();
+    void parseBlock(const Range &range, Block &block, Scratch &scratch, ParentSetStore &store) const;
+    MappedFile file;
+    int n;
+    int numSets;
+    size_t listSize;
+    std::vector<Range> ranges;
+    std::vector<Block> blocks;
+    double seconds;
+};
+
+#endif /* SCOREPARSER_H */
@@ -0,0 +1,13 @@
+#include "scoringworkspace.h"
+#include "debug.h"
+
+ScoringWorkspace::ScoringWorkspace(int n) :
+  pred(n, 0), forwardPred(n, 0), backwardPred(n, 0),
+  parents(n), scores(n),
+  passedParents(n), passedScores(n), firstScore(n), reach(n), positions(n), pivots(n), lastImproved(n), n(n) {
+  improved.reserve(n);
+}
+
+int ScoringWorkspace::getN() const {
+  return n;
+}
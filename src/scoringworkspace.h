@@ -0,0 +1,44 @@
+#ifndef SCORINGWORKSPACE_H
+#define SCORINGWORKSPACE_H
+
+#include <utility>
+#include <vector>
+#include "ordering.h"
+#include "pivotqueue.h"
+#include "types.h"
+
+// Scratch state for scoring orderings. Every buffer is sized for n variables
+// once, so the local search loops that pass a workspace around reuse it
+// instead of allocating. Each search thread owns its own workspace.
+class ScoringWorkspace {
+  public:
+    ScoringWorkspace(int n);
+    int getN() const;
+    // Predecessor masks.
+    Types::Bitset pred;
+    Types::Bitset forwardPred;
+    Types::Bitset backwardPred;
+    // Best parent set id and score per variable for the current ordering.
+    std::vector<int> parents;
+    std::vector<Types::Score> scores;
+    // Recorded by getBestInsertFast and getInsertScore for applyBestInsert: the parent set and
+    // score of each variable the pivot passed over, by variable, and of the
+    // pivot itself, by destination. getSwapDelta records the variables
+    // between the swapped positions for applySwap the same way.
+    std::vector<int> passedParents;
+    std::vector<Types::Score> passedScores;
+    std::vector<std::pair<Types::Score, int>> firstScore;
+    // Best score the pivot of getInsertScore can reach, by position.
+    std::vector<Types::Score> reach;
+    // Pivot visiting order of hillClimb.
+    std::vector<int> positions;
+    PivotQueue pivots;
+    // Pivots of hillClimb that improved since its last full pass, and the
+    // step of each variable's last improving move.
+    std::vector<int> improved;
+    std::vector<int> lastImproved;
+  private:
+    int n;
+};
+
+#endif /* SCORINGWORKSPACE_H */
@@ -0,0 +1,110 @@
+#ifndef SMALLBITSET_H
+#define SMALLBITSET_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+// Bitset over a run-time number of bits which keeps up to INLINE_BLOCKS words
+// inside the object itself. Every instance we search has n <= 512, so
+// predecessor sets live on the stack and copying one is a short memcpy; larger
+// instances fall back to a heap buffer with the same interface.
+class SmallBitset {
+  public:
+    typedef uint64_t Block;
+    static const int BLOCK_BITS = 64;
+    static const int INLINE_BLOCKS = 8;
+
+    class reference {
+      public:
+        reference(Block &block, Block mask) : block(block), mask(mask) { }
+        operator bool() const { return (block & mask) != 0; }
+        bool operator!() const { return (block & mask) == 0; }
+        reference &operator=(bool value) {
+          if (value) {
+            block |= mask;
+          } else {
+            block &= ~mask;
+          }
+          return *this;
+        }
+        reference &operator=(const reference &r) { return *this = (bool)r; }
+      private:
+        Block &block;
+        Block mask;
+    };
+
+    SmallBitset() : nBits(0), nBlocks(0) { }
+    SmallBitset(int n, unsigned long value = 0) : nBits(n), nBlocks((n + BLOCK_BITS - 1) / BLOCK_BITS) {
+      if (nBlocks > INLINE_BLOCKS) {
+        heap.resize(nBlocks);
+      }
+      reset();
+      if (value && nBits > 0) {
+        blocks()[0] = value;
+        trim();
+      }
+    }
+
+    bool operator[](int i) const { return (blocks()[i / BLOCK_BITS] >> (i % BLOCK_BITS)) & 1; }
+    reference operator[](int i) { return reference(blocks()[i / BLOCK_BITS], (Block)1 << (i % BLOCK_BITS)); }
+    bool test(int i) const { return (*this)[i]; }
+    void set(int i) { blocks()[i / BLOCK_BITS] |= (Block)1 << (i % BLOCK_BITS); }
+    void reset(int i) { blocks()[i / BLOCK_BITS] &= ~((Block)1 << (i % BLOCK_BITS)); }
+    void reset() { std::memset(blocks(), 0, nBlocks * sizeof(Block)); }
+    int size() const { return nBits; }
+    int numBlocks() const { return nBlocks; }
+    const Block *blocks() const { return nBlocks <= INLINE_BLOCKS ? inlineBlocks : heap.data(); }
+    Block *blocks() { return nBlocks <= INLINE_BLOCKS ? inlineBlocks : heap.data(); }
+
+    // True iff every bit of mask (nBlocks words) is also set here.
+    bool contains(const Block *mask) const {
+      const Block *own = blocks();
+      for (int b = 0; b < nBlocks; b++) {
+        if (mask[b] & ~own[b]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool operator==(const SmallBitset &o) const {
+      return nBits == o.nBits && std::memcmp(blocks(), o.blocks(), nBlocks * sizeof(Block)) == 0;
+    }
+    bool operator!=(const SmallBitset &o) const { return !(*this == o); }
+    SmallBitset &operator&=(const SmallBitset &o) {
+      Block *own = blocks();
+      const Block *other = o.blocks();
+      for (int b = 0; b < nBlocks; b++) {
+        own[b] &= other[b];
+      }
+      return *this;
+    }
+    SmallBitset operator&(const SmallBitset &o) const {
+      SmallBitset ret(*this);
+      ret &= o;
+      return ret;
+    }
+
+    // Same format as boost::dynamic_bitset: highest index first.
+    friend std::ostream& operator<<(std::ostream &os, const SmallBitset &s) {
+      for (int i = s.nBits - 1; i >= 0; i--) {
+        os << s[i];
+      }
+      return os;
+    }
+
+  private:
+    void trim() {
+      if (nBits % BLOCK_BITS) {
+        blocks()[nBlocks - 1] &= ((Block)1 << (nBits % BLOCK_BITS)) - 1;
+      }
+    }
+    int nBits;
+    int nBlocks;
+    Block inlineBlocks[INLINE_BLOCKS];
+    std::vector<Block> heap;
+};
+
+#endif /* SMALLBITSET_H */
@@ -0,0 +1,238 @@
+#include "subsetkernel.h"
+#include "debug.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SUBSETKERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool isSubset(const Types::Block *mask, int numBlocks, const Types::Block *pred) {
+  for (int b = 0; b < numBlocks; b++) {
+    if (mask[b] & ~pred[b]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int firstScalar(const Types::Block *masks, int numBlocks, int count, const Types::Block *pred) {
+  if (numBlocks == 1) {
+    Types::Block notPred = ~pred[0];
+    for (int i = 0; i < count; i++) {
+      if (!(masks[i] & notPred)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    if (isSubset(masks + (size_t)i * numBlocks, numBlocks, pred)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int firstIndexedScalar(const Types::Block *masks, int numBlocks, const int *ids, int count, const Types::Block *pred) {
+  for (int k = 0; k < count; k++) {
+    if (isSubset(masks + (size_t)ids[k] * numBlocks, numBlocks, pred)) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+#ifdef SUBSETKERNEL_X86
+
+__attribute__((target("avx2")))
+int firstAVX2(const Types::Block *masks, int numBlocks, int count, const Types::Block *pred) {
+  int i = 0;
+  if (numBlocks == 1) {
+    // Four single-word sets per register.
+    const __m256i notPred = _mm256_set1_epi64x(~pred[0]);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= count; i += 4) {
+      __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(masks + i)), notPred);
+      int hit = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, zero)));
+      if (hit) {
+        return i + __builtin_ctz(hit);
+      }
+    }
+    for (; i < count; i++) {
+      if (!(masks[i] & ~pred[0])) {
+        return i;
+      }
+    }
+    return -1;
+  }
+  if (numBlocks < 4) {
+    return firstScalar(masks, numBlocks, count, pred);
+  }
+  // Wide sets: test each set four words at a time.
+  int vecBlocks = numBlocks & ~3;
+  for (; i < count; i++) {
+    const Types::Block *mask = masks + (size_t)i * numBlocks;
+    __m256i acc = _mm256_setzero_si256();
+    for (int b = 0; b < vecBlocks; b += 4) {
+      __m256i m = _mm256_loadu_si256((const __m256i *)(mask + b));
+      __m256i p = _mm256_loadu_si256((const __m256i *)(pred + b));
+      acc = _mm256_or_si256(acc, _mm256_andnot_si256(p, m));
+    }
+    Types::Block rest = 0;
+    for (int b = vecBlocks; b < numBlocks; b++) {
+      rest |= mask[b] & ~pred[b];
+    }
+    if (!rest && _mm256_testz_si256(acc, acc)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx2")))
+int firstIndexedAVX2(const Types::Block *masks, int numBlocks, const int *ids, int count, const Types::Block *pred) {
+  if (numBlocks != 1) {
+    return firstIndexedScalar(masks, numBlocks, ids, count, pred);
+  }
+  const __m256i notPred = _mm256_set1_epi64x(~pred[0]);
+  const __m256i zero = _mm256_setzero_si256();
+  int k = 0;
+  for (; k + 4 <= count; k += 4) {
+    __m128i idx = _mm_loadu_si128((const __m128i *)(ids + k));
+    __m256i v = _mm256_i32gather_epi64((const long long *)masks, idx, 8);
+    v = _mm256_and_si256(v, notPred);
+    int hit = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, zero)));
+    if (hit) {
+      return k + __builtin_ctz(hit);
+    }
+  }
+  for (; k < count; k++) {
+    if (!(masks[ids[k]] & ~pred[0])) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx512f")))
+int firstAVX512(const Types::Block *masks, int numBlocks, int count, const Types::Block *pred) {
+  int i = 0;
+  if (numBlocks == 1) {
+    // Eight single-word sets per register.
+    const __m512i notPred = _mm512_set1_epi64(~pred[0]);
+    for (; i + 8 <= count; i += 8) {
+      __m512i v = _mm512_loadu_si512((const void *)(masks + i));
+      __mmask8 bad = _mm512_test_epi64_mask(v, notPred);
+      if (bad != 0xff) {
+        return i + __builtin_ctz(~bad & 0xff);
+      }
+    }
+    if (i < count) {
+      __mmask8 tail = (__mmask8)((1u << (count - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi64(tail, (const void *)(masks + i));
+      __mmask8 good = ~_mm512_test_epi64_mask(v, notPred) & tail;
+      if (good) {
+        return i + __builtin_ctz(good);
+      }
+    }
+    return -1;
+  }
+  if (numBlocks <= 8) {
+    // One masked load covers a whole set.
+    __mmask8 lanes = (__mmask8)((1u << numBlocks) - 1);
+    const __m512i p = _mm512_maskz_loadu_epi64(lanes, (const void *)pred);
+    for (; i < count; i++) {
+      __m512i m = _mm512_maskz_loadu_epi64(lanes, (const void *)(masks + (size_t)i * numBlocks));
+      __m512i outside = _mm512_maskz_andnot_epi64(0xff, p, m);
+      if (!_mm512_test_epi64_mask(outside, outside)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+  return firstAVX2(masks, numBlocks, count, pred);
+}
+
+__attribute__((target("avx512f")))
+int firstIndexedAVX512(const Types::Block *masks, int numBlocks, const int *ids, int count, const Types::Block *pred) {
+  if (numBlocks != 1) {
+    return firstIndexedAVX2(masks, numBlocks, ids, count, pred);
+  }
+  const __m512i notPred = _mm512_set1_epi64(~pred[0]);
+  int k = 0;
+  for (; k + 8 <= count; k += 8) {
+    __m256i idx = _mm256_loadu_si256((const __m256i *)(ids + k));
+    __m512i v = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), 0xff, idx, (const void *)masks, 8);
+    __mmask8 bad = _mm512_test_epi64_mask(v, notPred);
+    if (bad != 0xff) {
+      return k + __builtin_ctz(~bad & 0xff);
+    }
+  }
+  for (; k < count; k++) {
+    if (!(masks[ids[k]] & ~pred[0])) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+#endif /* SUBSETKERNEL_X86 */
+
+}
+
+SubsetKernel::Level SubsetKernel::detect() {
+#ifdef SUBSETKERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return AVX2;
+  }
+#endif
+  return SCALAR;
+}
+
+bool SubsetKernel::setLevel(Level level) {
+  if (level > detect()) {
+    return false;
+  }
+  impl.level = level;
+  impl.first = firstScalar;
+  impl.firstIndexed = firstIndexedScalar;
+#ifdef SUBSETKERNEL_X86
+  if (level == AVX2) {
+    impl.first = firstAVX2;
+    impl.firstIndexed = firstIndexedAVX2;
+  } else if (level == AVX512) {
+    impl.first = firstAVX512;
+    impl.firstIndexed = firstIndexedAVX512;
+  }
+#endif
+  DBG("Subset kernel: " << getName());
+  return true;
+}
+
+SubsetKernel::Level SubsetKernel::getLevel() {
+  return impl.level;
+}
+
+std::string SubsetKernel::getName() {
+  if (impl.level == AVX512) {
+    return "avx512";
+  } else if (impl.level == AVX2) {
+    return "avx2";
+  }
+  return "scalar";
+}
+
+SubsetKernel::Impl SubsetKernel::impl = { SubsetKernel::SCALAR, firstScalar, firstIndexedScalar };
+
+namespace {
+// Pick the widest kernel the CPU supports before main() runs.
+struct KernelInit {
+  KernelInit() { SubsetKernel::setLevel(SubsetKernel::detect()); }
+} kernelInit;
+}
@@ -0,0 +1,38 @@
+#ifndef SUBSETKERNEL_H
+#define SUBSETKERNEL_H
+
+#include <string>
+#include "types.h"
+
+// Vectorized "first parent set consistent with pred" scans over packed masks.
+// Masks are stored back to back, numBlocks words per set. The implementation
+// (AVX-512, AVX2 or scalar) is picked once from the running CPU.
+class SubsetKernel {
+  public:
+    enum Level {
+      SCALAR,
+      AVX2,
+      AVX512
+    };
+    // Index of the first of the count masks that is a subset of pred, or -1.
+    static int firstSubset(const Types::Block *masks, int numBlocks, int count, const Types::Block *pred) {
+      return impl.first(masks, numBlocks, count, pred);
+    }
+    // Same, over the masks at masks[ids[k] * numBlocks]; returns k or -1.
+    static int firstSubsetIndexed(const Types::Block *masks, int numBlocks, const int *ids, int count, const Types::Block *pred) {
+      return impl.firstIndexed(masks, numBlocks, ids, count, pred);
+    }
+    static Level detect();
+    static bool setLevel(Level level);
+    static Level getLevel();
+    static std::string getName();
+  private:
+    struct Impl {
+      Level level;
+      int (*first)(const Types::Block *, int, int, const Types::Block *);
+      int (*firstIndexed)(const Types::Block *, int, const int *, int, const Types::Block *);
+    };
+    static Impl impl;
+};
+
+#endif /* SUBSETKERNEL_H */
@@ -1,30 +1,31 @@
 #include "swaptabulist.h"
 #include "debug.h"
 
-SwapTabuList::SwapTabuList(int size) : MAX_SIZE(size) { }
+SwapTabuList::SwapTabuList(int size, int n) : MAX_SIZE(size), n(n) {
+  pairCounts.reserve(size + 1);
+}
 
 void SwapTabuList::add(int a, int b) {
   if (b < a) {
     std::swap(a, b);
   }
   _list.push_back(std::make_pair(a, b));
+  ++pairCounts[key(a, b)];
   if (_list.size() > MAX_SIZE) {
+    const std::pair<int, int> &popped = _list.front();
+    std::unordered_map<uint64_t, int>::iterator it = pairCounts.find(key(popped.first, popped.second));
+    if (--it->second == 0) {
+      pairCounts.erase(it);
+    }
     _list.pop_front();
   }
 }
 
 bool SwapTabuList::contains(int a, int b) {
-  int lsize = _list.size();
   if (b < a) {
     std::swap(a, b);
   }
-  for (int i = 0; i < lsize; i++) {
-    const std::pair<int, int> &p = _list[i];
-    if (p.first == a && p.second == b) {
-      return true;
-    }
-  }
-  return false;
+  return pairCounts.count(key(a, b)) > 0;
 }
 
 void SwapTabuList::print() {
@@ -1,18 +1,27 @@
 #include<deque>
+#include<unordered_map>
+#include<stdint.h>
+#include<vector>
 #include "ordering.h"
 
 #ifndef SWAPTABULIST_H
 #define SWAPTABULIST_H 
 
+// The last MAX_SIZE swapped pairs of variables, with a hashed count per pair
+// for constant time lookups in memory proportional to the tenure.
 class SwapTabuList {
   public:
     int MAX_SIZE;
     void add(int a, int b);
-    SwapTabuList(int size);
+    SwapTabuList(int size, int n);
     bool contains(int a, int b);
     void print();
   private:
     std::deque<std::pair<int, int>> _list;
+    int n;
+    // Nonzero counts only, by key(a, b) with a < b.
+    std::unordered_map<uint64_t, int> pairCounts;
+    static uint64_t key(int a, int b) { return (uint64_t)a << 32 | (uint32_t)b; }
 };
 
-#endif /* SWAPTABULIST_H */
\ No newline at end of file
+#endif /* SWAPTABULIST_H */
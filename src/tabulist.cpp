@@ -1,21 +1,37 @@
 #include "tabulist.h"
 #include "debug.h"
 
-TabuList::TabuList(int size) : MAX_SIZE(size) { }
+TabuList::TabuList(int size) : MAX_SIZE(size), next(0) {
+  _list.reserve(size);
+  slots.reserve(size);
+}
 
 void TabuList::add(const Ordering &o) {
-  _list.push_back(o);
-  if (_list.size() > MAX_SIZE) {
-    _list.pop_front();
+  if (MAX_SIZE <= 0) {
+    return;
+  }
+  if ((int)_list.size() < MAX_SIZE) {
+    _list.push_back(o);
+  } else {
+    auto range = slots.equal_range(_list[next].getHash());
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == next) {
+        slots.erase(it);
+        break;
+      }
+    }
+    _list[next] = o;
   }
+  slots.insert(std::make_pair(o.getHash(), next));
+  next = next + 1 == MAX_SIZE ? 0 : next + 1;
 }
 
 bool TabuList::contains(const Ordering &o) {
-  int n = _list.size();
-  for (int i = 0; i < n; i++) {
-    if (o.equals(_list[i])) {
+  auto range = slots.equal_range(o.getHash());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (o.equals(_list[it->second])) {
       return true;
     }
   }
   return false;
-}
\ No newline at end of file
+}
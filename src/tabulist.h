@@ -1,9 +1,13 @@
-#include<deque>
+#include<cstdint>
+#include<unordered_map>
+#include<vector>
 #include "ordering.h"
 
 #ifndef TABULIST_H
 #define TABULIST_H 
 
+// The last MAX_SIZE orderings added, in a ring buffer indexed by their hash;
+// orderings are only compared in full when their hashes match.
 class TabuList {
   public:
     int MAX_SIZE;
@@ -11,7 +15,10 @@ class TabuList {
     TabuList(int size);
     bool contains(const Ordering &o);
   private:
-    std::deque<Ordering> _list;
+    std::vector<Ordering> _list;
+    // Next slot of _list to overwrite.
+    int next;
+    std::unordered_multimap<uint64_t, int> slots;
 };
 
-#endif /* TABULIST_H */
\ No newline at end of file
+#endif /* TABULIST_H */
@@ -1,13 +1,15 @@
 #ifndef TYPES_H
 #define TYPES_H
 
-#include <boost/dynamic_bitset.hpp>
 #include <climits>
+#include "smallbitset.h"
 
 class Types {
   public:
     typedef int64_t Score;
-    typedef boost::dynamic_bitset<uint64_t> Bitset;
+    typedef SmallBitset::Block Block;
+    typedef SmallBitset Bitset;
+    static const int BLOCK_BITS = SmallBitset::BLOCK_BITS;
     static const Score SCORE_MAX = 9223372036854775807LL;
 };
  
@@ -8,9 +8,9 @@ bool Util::isOpt(const SearchResult &sr, const Types::Score &opt) {
   return 100*(diff/(double)opt) < EPSILON;
 }
 
-std::pair<int, int> Util::getUniquePair(int n) {
-  int i = rand()%n;
-  int j = rand()%(n-1);
+std::pair<int, int> Util::getUniquePair(int n, Rng &rng) {
+  int i = rng.uniform(n);
+  int j = rng.uniform(n-1);
   if (j >= i) {
     j += 1;
   }
@@ -2,11 +2,12 @@
 #define UTIL_H 
 #include "searchresult.h"
 #include <utility>
+#include "rng.h"
 #include "types.h"
 class Util {
   public:
     static bool isOpt(const SearchResult &sr, const Types::Score &opt);
-    static std::pair<int, int> getUniquePair(int n);
+    static std::pair<int, int> getUniquePair(int n, Rng &rng);
 };
 
 #endif /* UTIL_H */
\ No newline at end of file
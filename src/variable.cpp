@@ -1,22 +1,45 @@
 #include "variable.h"
 #include "debug.h"
-Variable::Variable(int numParents, int varId, int n) :
-  parentsWithVar(), nParents(numParents),  varId(varId) { }
+#include <algorithm>
+Variable::Variable(const ParentSetStore *store, int offset, int numParents, int varId, const ParentIndex *index, int indexSlot) :
+  store(store), offset(offset), nParents(numParents), varId(varId), index(index), indexSlot(indexSlot),
+  useIndex(index != NULL && index->prefersIndex(indexSlot, store->getNumBlocks())) { }
 
-Variable::Variable() { };
+Variable::Variable() : store(NULL), offset(0), nParents(0), varId(-1), index(NULL), indexSlot(-1), useIndex(false) { };
 
-void Variable::addParentSet(ParentSet parentSet) {
-  parents.push_back(parentSet);
+// Best set containing parent that is consistent with pred among the ranks < limit, or -1.
+int Variable::firstConsistentWithParent(const Types::Bitset &pred, int parent, int limit) const {
+  if (useIndex) {
+    return index->firstConsistent(indexSlot, pred, limit, parent);
+  }
+  ParentList candidates = store->withParent(varId, parent);
+  int n = std::lower_bound(candidates.begin(), candidates.end(), limit) - candidates.begin();
+  int k = store->firstSubsetOf(offset, candidates.begin(), n, pred);
+  return k == -1 ? -1 : candidates[k];
 }
 
-const ParentSet &Variable::getParent(int i) const {
-  return parents[i];
+int Variable::firstConsistentAt(const int *positions, int position, int extra) const {
+  for (int i = 0; i < nParents; i++) {
+    if (store->precedes(offset + i, positions, position, extra)) {
+      return i;
+    }
+  }
+  return -1;
 }
 
-void Variable::parentSort() {
-  std::sort(parents.begin(), parents.end(), [](ParentSet a, ParentSet b) {
-    return a.getScore() < b.getScore();
-  });
+int Variable::firstConsistentWithParentAt(const int *positions, int position, int parent, int limit) const {
+  ParentList candidates = store->withParent(varId, parent);
+  int n = candidates.size();
+  for (int k = 0; k < n && candidates[k] < limit; k++) {
+    if (store->precedes(offset + candidates[k], positions, position, parent)) {
+      return candidates[k];
+    }
+  }
+  return -1;
+}
+
+const Types::Score *Variable::getScores() const {
+  return store->getScores(offset);
 }
 
 int Variable::numParents() const {
@@ -26,33 +49,11 @@ int Variable::numParents() const {
 std::ostream& operator<<(std::ostream &os, const Variable& v) {
   os << "Parents of Variable " << v.varId << ":" << std::endl;
   for (int i = 0; i < v.nParents; i++) {
-    os << "Id: " << i << " " << v.parents[i] << std::endl;
+    os << "Id: " << i << " " << v.getParent(i) << std::endl;
   }
   return os;
 }
 
-void Variable::resetParentIds() {
-  for (int j = 0; j < nParents; j++) {
-    parents[j].setId(j);
-  }
-}
-
-void Variable::initParentsWithVar() {
-  int n = numParents();
-  for (int i = 0; i < n; i++) {
-    const std::vector<int> &parentsVec = getParent(i).getParentsVec();
-    int m = parentsVec.size();
-    for (int j = 0; j < m; j++) {
-      int parentVarId = parentsVec[j];
-      parentsWithVar[parentVarId].push_back(getParent(i).getId()); // Should just be i, but just in case)
-    }
-  }
-}
-
-std::unordered_map<int, std::vector<int>>::const_iterator Variable::parentsWithVarId(int i)  const {
-  return parentsWithVar.find(i);
-}
-
 int Variable::getId() const {
   return varId;
-}
\ No newline at end of file
+}
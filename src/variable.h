@@ -2,27 +2,38 @@
 #define VARIABLE_H 
 
 #include"parentset.h"
-#include<unordered_map>
+#include"parentsetstore.h"
+#include"parentindex.h"
 
 
 class Variable {
   public:
-    Variable(int numParents, int varId, int n);
+    Variable(const ParentSetStore *store, int offset, int numParents, int varId, const ParentIndex *index, int indexSlot);
     Variable();
-    void addParentSet(ParentSet parentSet);
     int numParents() const;
-    const ParentSet &getParent(int i) const;
-    void parentSort();
+    ParentSet getParent(int i) const { return ParentSet(store, offset + i, varId, i); }
+    bool isConsistent(int i, const Types::Bitset &pred) const { return store->subsetOf(offset + i, pred); }
+    int firstConsistent(const Types::Bitset &pred) const {
+      return useIndex ? index->firstConsistent(indexSlot, pred, nParents, -1) : store->firstSubset(offset, nParents, pred);
+    }
+    int firstConsistentWithParent(const Types::Bitset &pred, int parent, int limit) const;
+    // Position based variants: a set is consistent iff each of its parents is
+    // extra/parent or sits in positions[] before position.
+    int firstConsistentAt(const int *positions, int position, int extra) const;
+    int firstConsistentWithParentAt(const int *positions, int position, int parent, int limit) const;
+    const Types::Score *getScores() const;
     friend std::ostream& operator<<(std::ostream &os, const Variable& v);
-    void resetParentIds();
-    void initParentsWithVar();
-    std::unordered_map<int, std::vector<int>>::const_iterator parentsWithVarId(int i) const;
     int getId() const;
-    std::unordered_map<int, std::vector<int>> parentsWithVar;
+    int getOffset() const { return offset; }
+    int getIndexSlot() const { return indexSlot; }
   private:
+    const ParentSetStore *store;
+    int offset;
     int nParents;
-    std::vector<ParentSet> parents;
     int varId;
+    const ParentIndex *index;
+    int indexSlot;
+    bool useIndex;
 };
 
-#endif /* VARIABLE_H */
\ No newline at end of file
+#endif /* VARIABLE_H */
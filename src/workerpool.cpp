@@ -0,0 +1,83 @@
+#include "workerpool.h"
+#include "debug.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int numThreads) :
+  task(NULL), numTasks(0), next(0), failed(false), error(NULL), busy(0), batch(0), stopping(false) {
+  numThreads = std::max(1, numThreads);
+  for (int t = 1; t < numThreads; t++) {
+    threads.push_back(std::thread(&WorkerPool::loop, this, t));
+  }
+  DBG("Worker pool with " << numThreads << " threads");
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+int WorkerPool::getNumThreads() const {
+  return threads.size() + 1;
+}
+
+void WorkerPool::run(int numTasks, const std::function<void(int, int)> &task) {
+  if (numTasks <= 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->task = &task;
+    this->numTasks = numTasks;
+    next = 0;
+    failed = false;
+    error = NULL;
+    busy = threads.size();
+    batch++;
+  }
+  wake.notify_all();
+  drain(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() { return busy == 0; });
+  this->task = NULL;
+  if (failed) {
+    throw error;
+  }
+}
+
+void WorkerPool::loop(int worker) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen]() { return stopping || batch != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = batch;
+    }
+    drain(worker);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--busy == 0) {
+      finished.notify_one();
+    }
+  }
+}
+
+// Tasks vary a lot in cost, so each worker takes the next unstarted one.
+void WorkerPool::drain(int worker) {
+  try {
+    for (int i = next++; i < numTasks && !failed; i = next++) {
+      (*task)(i, worker);
+    }
+  } catch (const char *e) {
+    if (!failed.exchange(true)) {
+      error = e;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run batches of independent tasks. The thread
+// calling run works as worker 0, so a pool of one thread runs everything
+// inline. Tasks that throw a const char * stop the batch and the error is
+// rethrown from run.
+class WorkerPool {
+  public:
+    WorkerPool(int numThreads);
+    ~WorkerPool();
+    int getNumThreads() const;
+    // Calls task(i, worker) for every i in [0, numTasks) and returns once all
+    // calls are done. worker, in [0, getNumThreads()), is stable for the
+    // calling thread and indexes per-thread state.
+    void run(int numTasks, const std::function<void(int, int)> &task);
+  private:
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+    void loop(int worker);
+    void drain(int worker);
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(int, int)> *task;
+    int numTasks;
+    std::atomic<int> next;
+    std::atomic<bool> failed;
+    const char *error;
+    int busy;
+    unsigned long batch;
+    bool stopping;
+};
+
+#endif /* WORKERPOOL_H */